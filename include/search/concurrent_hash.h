@@ -0,0 +1,61 @@
+#ifndef CONCURRENT_HASH_H
+#define CONCURRENT_HASH_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#define CONCURRENT_MAX_THREADS 128
+#define CONCURRENT_MIN_LENGTH 256
+#define CONCURRENT_MIGRATE_CHUNK 1024
+
+// Reserved values: a deleted key and a slot that has moved to the next table
+#define CONCURRENT_TOMBSTONE INT_MIN
+#define CONCURRENT_MOVED (INT_MIN + 1)
+
+/*
+ * Open-addressing table as in HashTable: linear probing from
+ * Hash(key) & (length - 1), NULLKEY marking empty slots. Each slot packs
+ * key and value into one 64-bit word, so it changes with a single CAS.
+ */
+typedef struct ConcurrentTable {
+    uint64_t *slots;
+    int length;                         // power of two
+    int claimed;                        // slots that hold a key, deleted ones included
+    struct ConcurrentTable *next;       // table being migrated into, NULL when idle
+    int migrateIndex;                   // next chunk to hand out
+    int migrated;                       // slots migrated so far
+    struct ConcurrentTable *retiredNext;
+} ConcurrentTable;
+
+typedef struct {
+    int epoch;
+    int active;
+    char pad[56];                       // one record per cache line
+} EpochRecord;
+
+typedef struct {
+    ConcurrentTable *root;
+    int count;
+    int globalEpoch;
+    int threadCount;
+    EpochRecord threads[CONCURRENT_MAX_THREADS];
+    pthread_mutex_t retireLock;
+    ConcurrentTable *retired[3];        // tables retired in each epoch mod 3
+    int retiredCount;
+} ConcurrentHashMap;
+
+int ConcurrentHashInit(ConcurrentHashMap *map, int size);
+// Not thread-safe: call once every other thread is done with the map
+void ConcurrentHashDestroy(ConcurrentHashMap *map);
+
+// Every thread registers once and passes its id to the calls below; -1 when full
+int ConcurrentHashRegister(ConcurrentHashMap *map);
+
+int ConcurrentHashFind(ConcurrentHashMap *map, int thread, int key, int *value);
+// Insert or overwrite; 0 for NULLKEY or a reserved value
+int ConcurrentHashInsert(ConcurrentHashMap *map, int thread, int key, int value);
+int ConcurrentHashDelete(ConcurrentHashMap *map, int thread, int key);
+int ConcurrentHashCount(ConcurrentHashMap *map);
+
+#endif
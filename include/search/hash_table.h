@@ -4,15 +4,36 @@
 #define NULLKEY -1
 #define DELKEY -2
 
+#define HASH_MIN_LENGTH 8
+#define HASH_REHASH_STEP 64
+#define HASH_BATCH 64               // keys hashed per block by SearchHashBatch
+#define HASH_PREFETCH_DISTANCE 8    // keys between a prefetch and its probe
+
+// Keys NULLKEY and DELKEY mark empty and deleted slots and cannot be stored
 typedef struct {
     int *elem;
-    int count;
-    int length;
+    int count;              // keys stored, in both arrays while rehashing
+    int length;             // power of two
+    int used;               // slots of elem holding a key or DELKEY
+    int *oldElem;           // array being migrated into elem, NULL when idle
+    int oldLength;
+    int rehashIndex;        // next slot of oldElem to migrate
+    int *dist;              // probe distance + 1 per slot of elem (0 = empty), Robin Hood mode only
 } HashTable;
 
-int Hash(int key);
+// murmur3 32-bit finalizer; the home slot is Hash(key) & (length - 1)
+unsigned int Hash(int key);
+// size is rounded up to a power of two of at least HASH_MIN_LENGTH
 void InitHashTable(HashTable *H, int size);
+// Robin Hood mode: bounded probe lengths and deletion without tombstones
+void InitRobinHoodHashTable(HashTable *H, int size);
+void DestroyHashTable(HashTable *H);
+// Slot of key in elem, length + slot in oldElem while rehashing, or -1
 int SearchHash(HashTable H, int key);
+// SearchHash for keys[0..n-1] into out, prefetching home slots ahead of
+// the probes; returns the number of keys found
+int SearchHashBatch(const HashTable *H, const int *keys, int n, int *out);
+// 0 if the key is already present or cannot be stored
 int InsertHash(HashTable *H, int key);
 int DeleteHash(HashTable *H, int key);
 void PrintHashTable(HashTable H);
@@ -0,0 +1,42 @@
+#ifndef SWISS_MAP_H
+#define SWISS_MAP_H
+
+#include <stddef.h>
+
+#define SWISS_GROUP 16
+#define SWISS_MIN_CAPACITY 16
+
+/*
+ * Hash map with one control byte per slot: the low 7 bits of the hash for
+ * a full slot, or SWISS_EMPTY / SWISS_DELETED. Keys and values of any
+ * fixed size live in two arrays parallel to the control bytes, and keys
+ * are compared bytewise, so every bit pattern is a valid key.
+ */
+typedef struct {
+    signed char *ctrl;      // capacity control bytes, then SWISS_GROUP - 1 copies of the first ones
+    char *keys;
+    char *values;
+    size_t keySize;
+    size_t valueSize;
+    size_t capacity;        // power of two
+    size_t count;
+    size_t growthLeft;      // empty slots that may still be filled before a rehash
+} SwissMap;
+
+// capacity is a hint and rounded up; 0 on allocation failure
+int SwissMapInit(SwissMap *map, size_t keySize, size_t valueSize, size_t capacity);
+void SwissMapDestroy(SwissMap *map);
+
+// Insert key or overwrite its value; 0 on allocation failure
+int SwissMapInsert(SwissMap *map, const void *key, const void *value);
+// Value of key, or NULL; valid until the next insert
+void *SwissMapFind(const SwissMap *map, const void *key);
+int SwissMapErase(SwissMap *map, const void *key);
+
+/*
+ * Visit every entry in slot order, *iter starting at 0; returns 0 after
+ * the last one. Erasing the entry just returned is allowed, inserting is not.
+ */
+int SwissMapNext(const SwissMap *map, size_t *iter, const void **key, void **value);
+
+#endif
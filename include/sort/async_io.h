@@ -0,0 +1,42 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    ASYNC_IO_THREAD,        // one background thread doing fread/fwrite in submission order
+    ASYNC_IO_URING          // Linux io_uring at explicit file offsets
+} AsyncIoBackend;
+
+// One read or write in flight; the buffer must stay untouched until AsyncIoWait returns
+typedef struct AsyncRequest {
+    FILE *file;
+    char *buffer;
+    size_t bytes;
+    long long offset;
+    int write;
+    size_t done;            // bytes transferred so far
+    int complete;
+    int error;
+    struct AsyncRequest *next;
+} AsyncRequest;
+
+typedef struct AsyncIo AsyncIo;
+
+// ASYNC_IO_URING falls back to the thread backend where io_uring is unavailable
+AsyncIo *AsyncIoCreate(AsyncIoBackend backend);
+AsyncIoBackend AsyncIoGetBackend(const AsyncIo *io);
+void AsyncIoDestroy(AsyncIo *io);
+
+/*
+ * Queue a transfer of bytes at offset. The thread backend ignores offset
+ * and relies on the requests for each file being sequential.
+ */
+void AsyncIoSubmit(AsyncIo *io, AsyncRequest *req, FILE *file, void *buffer, size_t bytes,
+                   long long offset, int write);
+
+// Wait for req; returns the bytes transferred, short only at end of file or on error
+size_t AsyncIoWait(AsyncIo *io, AsyncRequest *req);
+
+#endif
@@ -31,15 +31,31 @@
  */
 #define MAX_RUNS 100
 
+/**
+ * ExternalSortEx limits
+ * Default memory budget, smallest and largest per-run merge buffer
+ * (in elements), and the fan-in cap when the config leaves it at 0
+ */
+#define EXTERNAL_SORT_DEFAULT_MEMORY (64 * 1024 * 1024)
+#define EXTERNAL_SORT_MIN_BLOCK (16 * 1024)
+#define EXTERNAL_SORT_MAX_BLOCK (1024 * 1024)
+#define EXTERNAL_SORT_MAX_FAN_IN 512
+
 /**
  * Run File Structure
  * Represents a sorted run file with its buffer
  */
 typedef struct {
     FILE *file;                      // File pointer to run file
-    int buffer[MEMORY_BUFFER];        // Input buffer for the run
+    int *buffer;                     // Input buffer for the run
+    int capacity;                    // Buffer size in elements
     int current;                     // Current read position in buffer
     int valid;                       // Number of valid elements in buffer
+    long long remaining;             // Elements left to read, -1 for the rest of the file
+    struct AsyncRun *async;          // Read-ahead state when pipelined, NULL otherwise
+    struct MappedRun *mapped;        // Mapping in mmap mode, NULL otherwise
+    int encoded;                     // File holds RunCodec blocks (run_codec.h)
+    int error;                       // A bad or truncated block ended the run early
 } RunFile;
 
 /**
@@ -50,8 +66,151 @@ typedef struct {
     int key;                         // Key value for comparison
     int runIndex;                    // Index of the run this value comes from
     int value;                       // Actual value
+    int exhausted;                   // Run has no more data (+infinity)
 } LoserTreeNode;
 
+/**
+ * Run generation method used by ExternalSort
+ * RUNS_QUICKSORT sorts MEMORY_BUFFER-sized chunks;
+ * RUNS_REPLACEMENT_SELECTION streams the input through a heap
+ */
+typedef enum {
+    RUNS_QUICKSORT,
+    RUNS_REPLACEMENT_SELECTION
+} RunGeneration;
+
+/**
+ * Counters of the last external sort
+ * Bytes are counted at every fread/fwrite of input, runs and output;
+ * the merge phase accounts for bytesRead - runBytesRead and
+ * bytesWritten - runBytesWritten
+ */
+typedef struct {
+    long long runs;                  // Initial runs created
+    long long bytesRead;             // Bytes read from input and run files
+    long long bytesWritten;          // Bytes written to run and output files
+    long long merges;                // K-way merges, intermediate and final
+    long long encodedValues;         // Values written to compressed runs
+    long long encodedBytes;          // Bytes those values took on disk
+    long long runBytesRead;          // Bytes read while generating runs
+    long long runBytesWritten;       // Bytes written while generating runs
+    long long mergePasses;           // Passes over the data, the final merge included
+    double runSeconds;               // Wall time of run generation
+    double mergeSeconds;             // Wall time of the merge passes
+} ExternalSortStats;
+
+extern ExternalSortStats externalSortStats;
+
+void ResetExternalSortStats(void);
+
+/**
+ * Select the run generation method (default RUNS_QUICKSORT)
+ *
+ * @param mode Run generation method
+ */
+void ExternalSortSetRunGeneration(RunGeneration mode);
+
+/**
+ * I/O mode of ExternalSortEx
+ * The pipelined modes double-buffer every read and write so that sorting
+ * and merging overlap with disk transfers; the mmap mode avoids the
+ * copies through read/write buffers for files that fit the page cache
+ */
+typedef enum {
+    EXTERNAL_IO_BLOCKING,            // fread/fwrite on the sorting thread
+    EXTERNAL_IO_THREAD,              // Background I/O thread
+    EXTERNAL_IO_URING,               // io_uring on Linux, EXTERNAL_IO_THREAD elsewhere
+    EXTERNAL_IO_MMAP                 // Memory-mapped files on POSIX, EXTERNAL_IO_BLOCKING elsewhere
+} ExternalSortIo;
+
+/**
+ * ExternalSortEx settings
+ */
+typedef struct {
+    size_t memoryBytes;              // Budget for run generation and merge buffers
+    const char *tempDir;             // Directory for run files (NULL = current directory)
+    int maxFanIn;                    // Most runs merged at once (0 = EXTERNAL_SORT_MAX_FAN_IN)
+    RunGeneration runGeneration;     // Run generation method
+    ExternalSortIo io;               // Blocking or pipelined I/O
+    int threads;                     // Threads sorting chunks and merging key ranges
+    int compressRuns;                // Delta-encode run files (not in mmap mode)
+    const char *jobDir;              // Resumable job directory (NULL = fresh directory under tempDir)
+    int dropConsumedRuns;            // Delete each run as soon as a merge has read it
+} ExternalSortConfig;
+
+/**
+ * Fill a config with the defaults
+ * 64 MB budget, current directory, quicksort runs, blocking I/O,
+ * one thread, uncompressed runs, a fresh job directory, runs deleted
+ * after each merge
+ *
+ * @param cfg Config to fill
+ */
+void ExternalSortDefaultConfig(ExternalSortConfig *cfg);
+
+/**
+ * External sort with a memory budget
+ * Sizes run buffers from cfg->memoryBytes and merges in several passes
+ * when there are more runs than the fan-in. Runs go to a directory of
+ * their own; calling again with the same cfg->jobDir after a crash
+ * resumes from the runs and merges logged in its manifest, provided the
+ * input is the same file (size, device, inode and modification time)
+ *
+ * @param inputFile Path to input file
+ * @param outputFile Path to output file
+ * @param cfg Settings, or NULL for the defaults
+ * @return 1 on success, 0 on failure
+ */
+int ExternalSortEx(const char *inputFile, const char *outputFile, const ExternalSortConfig *cfg);
+
+/**
+ * Record format of ExternalSortRecords
+ * RECORDS_FIXED: binary records of recordSize bytes;
+ * RECORDS_LINES: newline-terminated text lines (the last newline is optional)
+ */
+typedef enum {
+    RECORDS_FIXED,
+    RECORDS_LINES
+} RecordFormat;
+
+/**
+ * Record layout
+ * Keys compare as unsigned bytes (memcmp order), a key before its
+ * extensions; in lines the key is clipped to the line
+ */
+typedef struct {
+    RecordFormat format;
+    int recordSize;                  // Bytes per record (RECORDS_FIXED)
+    int keyOffset;                   // First key byte within the record or line
+    int keyLength;                   // Key bytes (0 = to the end of the record or line)
+} RecordLayout;
+
+/**
+ * External sort of fixed-size records or text lines by a byte key
+ * Records keep their payloads; lines are written with a trailing newline
+ *
+ * @param inputFile Path to input file
+ * @param outputFile Path to output file
+ * @param layout Record format and key position
+ * @param cfg Settings (memoryBytes, tempDir, maxFanIn; jobDir is ignored), or NULL for the defaults
+ * @return 1 on success, 0 on failure
+ */
+int ExternalSortRecords(const char *inputFile, const char *outputFile, const RecordLayout *layout,
+                        const ExternalSortConfig *cfg);
+
+/**
+ * Merge sorted record runs run_0 .. run_<runCount - 1> of runDir
+ * A run that cannot be read in full, or ends in a partial record, fails
+ * the merge instead of being cut short
+ *
+ * @param runDir Directory holding the run files
+ * @param runCount Number of runs, at least 1
+ * @param outputFile Path to output file
+ * @param layout Record format and key position the runs are sorted by
+ * @return 1 on success, 0 on failure
+ */
+int MergeRecordRuns(const char *runDir, int runCount, const char *outputFile, const RecordLayout *layout);
+
 /**
  * Main external sort function
  * Orchestrates run generation and merging
@@ -70,6 +229,15 @@ void ExternalSort(const char *inputFile, const char *outputFile);
  */
 int CreateRuns(const char *inputFile);
 
+/**
+ * Create initial sorted runs by replacement selection
+ * Runs average twice the heap size on random input
+ *
+ * @param inputFile Path to input file
+ * @return Number of runs created, or -1 on error
+ */
+int CreateRunsReplacementSelection(const char *inputFile);
+
 /**
  * Merge all sorted runs into single output
  * Opens all run files and performs k-way merge
@@ -79,6 +247,23 @@ int CreateRuns(const char *inputFile);
  */
 void MergeRuns(const char *outputFile, int runCount);
 
+/**
+ * Open a run file for merging with a buffer of capacity elements
+ *
+ * @param run Run structure to initialize
+ * @param filename Path to run file
+ * @param capacity Buffer size in elements
+ * @return 1 on success, 0 on failure
+ */
+int OpenRunFile(RunFile *run, const char *filename, int capacity);
+
+/**
+ * Close a run file and free its buffer
+ *
+ * @param run Run structure
+ */
+void CloseRunFile(RunFile *run);
+
 /**
  * K-way merge using simple method
  * Repeatedly selects minimum from all active runs
@@ -91,7 +276,7 @@ void KWayMerge(RunFile runs[], int k, FILE *output);
 
 /**
  * K-way merge using loser tree
- * More efficient for large number of runs
+ * Replays only the winner's leaf-to-root path, O(log k) per record
  *
  * @param runs Array of run structures
  * @param k Number of runs to merge
@@ -103,10 +288,10 @@ void LoserTreeMerge(RunFile runs[], int k, FILE *output);
  * Build loser tree for k-way merging
  * Loser tree tracks which run has the minimum value
  *
- * @param tree Loser tree array
+ * @param tree Loser tree array (k nodes, tree[0] is the winner)
  * @param runs Array of run structures
  * @param k Number of runs
- * @return Index of run with minimum value
+ * @return Index of run with minimum value, or -1 if all runs are empty
  */
 int BuildLoserTree(LoserTreeNode tree[], RunFile runs[], int k);
 
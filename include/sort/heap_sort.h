@@ -1,6 +1,7 @@
 #ifndef HEAP_SORT_HEADER
 #define HEAP_SORT_HEADER
 
+void HeapAdjust(int *a, int k, int len);
 void HeapSort(int *a, int n);
 
 #endif
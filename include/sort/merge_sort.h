@@ -2,5 +2,6 @@
 #define MERGE_SORT_H
 
 void MergeSort(int *a, int low, int high);
+void ParallelMergeSort(int *a, int n, int threads);
 
 #endif
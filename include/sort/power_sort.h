@@ -0,0 +1,6 @@
+#ifndef POWER_SORT_H
+#define POWER_SORT_H
+
+void PowerSort(int *a, int n);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef QUICK_SORT_H
 #define QUICK_SORT_H
 
+int Partition(int *a, int low, int high);
 void QuickSort(int *a, int low, int high);
 
 #endif
@@ -1,6 +1,18 @@
 #ifndef RADIX_SORT_H
 #define RADIX_SORT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+} KeyValue64;
+
 void RadixSort(int *a, int n);
 
+// In-place MSD radix (American flag) sort, not stable; top-level buckets are spread over threads
+void AmericanFlagSort64(uint64_t *a, size_t n, int threads);
+void AmericanFlagSortPairs(KeyValue64 *a, size_t n, int threads);
+
 #endif
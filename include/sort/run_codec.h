@@ -0,0 +1,19 @@
+#ifndef RUN_CODEC_H
+#define RUN_CODEC_H
+
+#define RUN_CODEC_BLOCK 128
+#define RUN_CODEC_HEADER 8
+// Largest encoding of one block: header plus 127 deltas of 32 bits
+#define RUN_CODEC_MAX_BYTES (RUN_CODEC_HEADER + (RUN_CODEC_BLOCK - 1) * 4)
+
+// Encode values[0..n), 1 <= n <= RUN_CODEC_BLOCK, into out; returns the bytes written
+int RunCodecEncodeBlock(const int *values, int n, unsigned char *out);
+
+// Total size of the block whose RUN_CODEC_HEADER bytes start at header,
+// -1 unless the header has 1 <= n <= RUN_CODEC_BLOCK and at most 32 bits
+int RunCodecBlockBytes(const unsigned char *header);
+
+// Decode one block into values; returns the number of values, 0 for a bad header
+int RunCodecDecodeBlock(const unsigned char *in, int *values);
+
+#endif
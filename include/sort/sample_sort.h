@@ -0,0 +1,11 @@
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+#include <stddef.h>
+
+void SampleSort(int *a, size_t n, int threads);
+
+// Extra bytes SampleSort allocates for n elements on the given number of threads
+size_t SampleSortMemory(size_t n, int threads);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SIMD_SORT_H
+#define SIMD_SORT_H
+
+#define SIMD_BLOCK_MAX 32
+
+// 1 when the CPU supports AVX2 and the SIMD kernels have not been disabled
+int SimdSortAvailable(void);
+void SimdSortEnable(int enable);
+
+// Bitonic sorting network for n <= SIMD_BLOCK_MAX, insertion sort otherwise
+void SortingNetwork(int *a, int n);
+
+// Merge sorted a[0..na) and b[0..nb) into out, which must not overlap them,
+// except that out may be b - na: b then sits at the end of the output and
+// the merge only ever writes below the next unread element of b
+void MergeSortedArrays(const int *a, int na, const int *b, int nb, int *out);
+
+#endif
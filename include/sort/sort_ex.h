@@ -0,0 +1,111 @@
+#ifndef SORT_EX_H
+#define SORT_EX_H
+
+#include <stddef.h>
+
+#define SORT_EX_CUTOFF 16
+
+typedef int (*SortCompare)(const void *x, const void *y);
+
+typedef enum {
+    SORT_INSERT,
+    SORT_SHELL,
+    SORT_QUICK,
+    SORT_HEAP,
+    SORT_MERGE
+} SortAlgorithm;
+
+// Sort n records of size bytes in place; returns 0 on bad arguments or allocation failure
+int SortEx(void *base, size_t n, size_t size, SortCompare cmp, SortAlgorithm algo);
+
+/*
+ * SORT_EX_DEFINE(Name, Type, LESS) defines static void Name(Type *a, size_t n),
+ * an introsort on Type records whose comparison LESS(x, y) is expanded inline:
+ *
+ *     #define RECORD_LESS(x, y) ((x).key < (y).key)
+ *     SORT_EX_DEFINE(SortRecords, Record, RECORD_LESS)
+ */
+#define SORT_EX_DEFINE(Name, Type, LESS)                                       \
+static void Name##InsertSort(Type *a, size_t n) {                              \
+    for (size_t i = 1; i < n; i++) {                                           \
+        if (LESS(a[i], a[i - 1])) {                                            \
+            Type temp = a[i];                                                  \
+            size_t j = i;                                                      \
+            do {                                                               \
+                a[j] = a[j - 1];                                               \
+                j--;                                                           \
+            } while (j > 0 && LESS(temp, a[j - 1]));                           \
+            a[j] = temp;                                                       \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Name##HeapAdjust(Type *a, size_t k, size_t len) {                  \
+    Type temp = a[k];                                                          \
+    for (size_t i = 2 * k + 1; i < len; i = 2 * i + 1) {                       \
+        if (i + 1 < len && LESS(a[i], a[i + 1])) i++;                          \
+        if (!LESS(temp, a[i])) break;                                          \
+        a[k] = a[i];                                                           \
+        k = i;                                                                 \
+    }                                                                          \
+    a[k] = temp;                                                               \
+}                                                                              \
+                                                                               \
+static void Name##HeapSort(Type *a, size_t n) {                                \
+    for (size_t i = n / 2; i-- > 0;) {                                         \
+        Name##HeapAdjust(a, i, n);                                             \
+    }                                                                          \
+    for (size_t i = n - 1; i > 0; i--) {                                       \
+        Type temp = a[0];                                                      \
+        a[0] = a[i];                                                           \
+        a[i] = temp;                                                           \
+        Name##HeapAdjust(a, 0, i);                                             \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Name##IntroSort(Type *a, size_t n, int depthLimit) {               \
+    while (n > SORT_EX_CUTOFF) {                                               \
+        if (depthLimit-- == 0) {                                               \
+            Name##HeapSort(a, n);                                              \
+            return;                                                            \
+        }                                                                      \
+        Type temp;                                                             \
+        size_t mid = n / 2, last = n - 1;                                      \
+        if (LESS(a[mid], a[0])) {                                              \
+            temp = a[mid]; a[mid] = a[0]; a[0] = temp;                         \
+        }                                                                      \
+        if (LESS(a[last], a[mid])) {                                           \
+            temp = a[last]; a[last] = a[mid]; a[mid] = temp;                   \
+            if (LESS(a[mid], a[0])) {                                          \
+                temp = a[mid]; a[mid] = a[0]; a[0] = temp;                     \
+            }                                                                  \
+        }                                                                      \
+        Type pivot = a[mid];                                                   \
+        a[mid] = a[0];                                                         \
+        size_t low = 0, high = last;                                           \
+        while (low < high) {                                                   \
+            while (low < high && LESS(pivot, a[high])) high--;                 \
+            if (low < high) a[low++] = a[high];                                \
+            while (low < high && LESS(a[low], pivot)) low++;                   \
+            if (low < high) a[high--] = a[low];                                \
+        }                                                                      \
+        a[low] = pivot;                                                        \
+        if (low < n - low - 1) {                                               \
+            Name##IntroSort(a, low, depthLimit);                               \
+            a += low + 1;                                                      \
+            n -= low + 1;                                                      \
+        } else {                                                               \
+            Name##IntroSort(a + low + 1, n - low - 1, depthLimit);             \
+            n = low;                                                           \
+        }                                                                      \
+    }                                                                          \
+    Name##InsertSort(a, n);                                                    \
+}                                                                              \
+                                                                               \
+static void Name(Type *a, size_t n) {                                          \
+    int depthLimit = 0;                                                        \
+    for (size_t m = n; m > 1; m >>= 1) depthLimit += 2;                        \
+    Name##IntroSort(a, n, depthLimit);                                         \
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SORT_STATS_H
+#define SORT_STATS_H
+
+/*
+ * Comparison and move counters for the int sorts
+ *
+ * SORT_CMP and SORT_MOVES compile to nothing unless the sorts are built
+ * with -DSORT_STATS. That build also turns the SIMD kernels off, so every
+ * comparison goes through counted scalar code. Moves count element writes
+ * into the array being sorted or its scratch buffer.
+ */
+
+typedef struct {
+    unsigned long long compares;
+    unsigned long long moves;
+} SortStats;
+
+extern SortStats sortStats;
+
+void ResetSortStats(void);
+
+#ifdef SORT_STATS
+#define SORT_CMP(e) (sortStats.compares++, (e))
+#define SORT_MOVES(k) (sortStats.moves += (k))
+#else
+#define SORT_CMP(e) (e)
+#define SORT_MOVES(k) ((void)0)
+#endif
+
+#endif
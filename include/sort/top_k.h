@@ -0,0 +1,20 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+// Streaming accumulator of the k smallest values, kept as a max-heap that grows on demand
+typedef struct {
+    int *data;
+    int length;
+    int capacity;
+    int k;
+} TopK;
+
+void NthElement(int *a, int n, int k);
+void PartialSort(int *a, int n, int k);
+
+int InitTopK(TopK *T, int k);
+void TopKPush(TopK *T, int x);
+int TopKResult(TopK *T, int *out);
+void DestroyTopK(TopK *T);
+
+#endif
@@ -51,7 +51,7 @@ del graph_input.txt
 
 echo.
 echo [10/10] Sorting Algorithms...
-gcc -I. -o test_sort.exe src/sort/*.c tests/sort/test_sort.c && test_sort.exe
+gcc -I. -pthread -o test_sort.exe src/sort/*.c tests/sort/test_sort.c && test_sort.exe
 
 echo.
 echo ========================================
@@ -0,0 +1,357 @@
+#include <sched.h>
+#include <stdlib.h>
+#include "include/search/concurrent_hash.h"
+#include "include/search/hash_table.h"
+
+/*
+ * Concurrent hash map
+ *
+ * A key is written into a slot once, by a CAS on an empty slot, and never
+ * leaves it; later writes only swap the value, and a delete stores
+ * CONCURRENT_TOMBSTONE. Two threads inserting the same key walk the same
+ * probe sequence, so the loser of the CAS finds the winner's key and
+ * updates it instead. Readers never write or retry: a lookup is a bounded
+ * walk over atomic loads.
+ *
+ * Resizing is cooperative. Once the table is 3/4 claimed, a writer
+ * installs a bigger table as next, and from then on every write first
+ * migrates one chunk of slots. A slot is migrated by copying its value to
+ * the next table and then freezing it with CONCURRENT_MOVED by CAS; if a
+ * writer changed the value in between, the CAS fails and the copy is
+ * redone. Empty slots are frozen too. Until its slot is frozen a key is
+ * only written in the old table, and readers and writers that meet a
+ * frozen slot continue in the next one. A probe that ends in a frozen
+ * empty slot shows the key is not in the old table, so a new key is then
+ * claimed in the next table right away. The next table must still have
+ * room for every copy to come, so such a claim first reserves a slot and
+ * is refused while the old slots not yet migrated could need them all;
+ * only then does the writer wait, helping the migration. The thread that
+ * migrates the last chunk makes the next table the root.
+ *
+ * A retired table may still be read by threads that entered before the
+ * switch, so it is freed by epoch-based reclamation: every operation
+ * announces the global epoch it started in, the epoch only advances when
+ * all active threads have seen it, and a table retired in epoch e is freed
+ * once the epoch reaches e + 3.
+ */
+
+// Slots are stored XORed with the empty slot, so zeroed memory reads as
+// empty and a new table comes from calloc without a pass over it
+#define EMPTY_SLOT (((uint64_t)(uint32_t)NULLKEY << 32) | (uint32_t)CONCURRENT_TOMBSTONE)
+
+static uint64_t Pack(int key, int value) {
+    return (((uint64_t)(uint32_t)key << 32) | (uint32_t)value) ^ EMPTY_SLOT;
+}
+
+static int KeyOf(uint64_t slot) {
+    return (int)(uint32_t)((slot ^ EMPTY_SLOT) >> 32);
+}
+
+static int ValueOf(uint64_t slot) {
+    return (int)(uint32_t)(slot ^ EMPTY_SLOT);
+}
+
+#define LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define CAS(p, expected, desired) \
+    __atomic_compare_exchange_n(p, expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+static ConcurrentTable *NewTable(int size) {
+    int length = CONCURRENT_MIN_LENGTH;
+    while (length < size && length < (1 << 30)) {
+        length <<= 1;
+    }
+    ConcurrentTable *t = (ConcurrentTable *)malloc(sizeof(ConcurrentTable));
+    uint64_t *slots = (uint64_t *)calloc(length, sizeof(uint64_t));
+    if (!t || !slots) {
+        free(t);
+        free(slots);
+        return NULL;
+    }
+    t->slots = slots;
+    t->length = length;
+    t->claimed = 0;
+    t->next = NULL;
+    t->migrateIndex = 0;
+    t->migrated = 0;
+    t->retiredNext = NULL;
+    return t;
+}
+
+static void FreeTable(ConcurrentTable *t) {
+    free(t->slots);
+    free(t);
+}
+
+static void EnterEpoch(ConcurrentHashMap *map, int thread) {
+    EpochRecord *record = &map->threads[thread];
+    __atomic_store_n(&record->epoch, LOAD(&map->globalEpoch), __ATOMIC_RELAXED);
+    __atomic_store_n(&record->active, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void ExitEpoch(ConcurrentHashMap *map, int thread) {
+    __atomic_store_n(&map->threads[thread].active, 0, __ATOMIC_RELEASE);
+}
+
+// Advance the epoch if every active thread has seen it, and free the
+// tables retired three epochs ago
+static void TryAdvanceEpoch(ConcurrentHashMap *map) {
+    if (pthread_mutex_trylock(&map->retireLock) != 0) return;
+    int epoch = map->globalEpoch;
+    int threads = LOAD(&map->threadCount);
+    if (threads > CONCURRENT_MAX_THREADS) threads = CONCURRENT_MAX_THREADS;
+    int quiet = 1;
+    for (int i = 0; i < threads && quiet; i++) {
+        quiet = !LOAD(&map->threads[i].active) || LOAD(&map->threads[i].epoch) == epoch;
+    }
+    if (quiet) {
+        __atomic_store_n(&map->globalEpoch, epoch + 1, __ATOMIC_SEQ_CST);
+        ConcurrentTable **list = &map->retired[(epoch + 1) % 3];
+        while (*list) {
+            ConcurrentTable *t = *list;
+            *list = t->retiredNext;
+            FreeTable(t);
+            __atomic_fetch_sub(&map->retiredCount, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&map->retireLock);
+}
+
+static void RetireTable(ConcurrentHashMap *map, ConcurrentTable *t) {
+    pthread_mutex_lock(&map->retireLock);
+    int epoch = map->globalEpoch;
+    t->retiredNext = map->retired[epoch % 3];
+    map->retired[epoch % 3] = t;
+    __atomic_fetch_add(&map->retiredCount, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&map->retireLock);
+}
+
+/*
+ * Reserve a slot of t, the table prev migrates into, for a key claimed
+ * directly. Every slot of prev not migrated yet may still be copied into
+ * t, so the reservation fails unless t keeps room for all of them.
+ * migrated only grows, so reading it before the add errs on the safe side.
+ */
+static int ReserveSlot(ConcurrentTable *t, ConcurrentTable *prev) {
+    int pending = prev->length - LOAD(&prev->migrated);
+    if (__atomic_add_fetch(&t->claimed, 1, __ATOMIC_ACQ_REL) <= t->length - pending) return 1;
+    __atomic_fetch_sub(&t->claimed, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * Set the value of key in t, following frozen slots into later tables
+ * A CONCURRENT_TOMBSTONE value deletes and never claims a slot. A new key
+ * is claimed in the first table whose probe ends in an empty slot that is
+ * not frozen; past t that takes a reservation (ReserveSlot).
+ *
+ * @return 1 if the key had a value, 0 if not, -1 if there was no slot to
+ *         claim: t is full or the table being migrated into has no room
+ *         to spare yet
+ */
+static int StoreValue(ConcurrentTable *t, int key, int value) {
+    ConcurrentTable *prev = NULL;
+    int reserved = 0;
+    int result = value == CONCURRENT_TOMBSTONE ? 0 : -1;
+    while (t) {
+        int mask = t->length - 1;
+        int addr = (int)(Hash(key) & mask);
+        ConcurrentTable *next = NULL;
+        for (int i = 0; i < t->length;) {
+            uint64_t slot = LOAD(&t->slots[addr]);
+            int k = KeyOf(slot), v = ValueOf(slot);
+            if (v == CONCURRENT_MOVED && (k == key || k == NULLKEY)) {
+                next = LOAD(&t->next);
+                break;
+            }
+            if (k == NULLKEY) {
+                if (value == CONCURRENT_TOMBSTONE) return 0;
+                if (prev && !reserved && !(reserved = ReserveSlot(t, prev))) return -1;
+                if (CAS(&t->slots[addr], &slot, Pack(key, value))) {
+                    if (!reserved) __atomic_fetch_add(&t->claimed, 1, __ATOMIC_RELAXED);
+                    return 0;
+                }
+                continue;           // lost the slot, look at it again
+            }
+            if (k == key) {
+                if (CAS(&t->slots[addr], &slot, Pack(key, value))) {
+                    result = v != CONCURRENT_TOMBSTONE;
+                    break;
+                }
+                continue;
+            }
+            addr = (addr + 1) & mask;
+            i++;
+        }
+        // A reservation left unused goes back before moving on or returning
+        if (reserved) {
+            __atomic_fetch_sub(&t->claimed, 1, __ATOMIC_RELAXED);
+            reserved = 0;
+        }
+        if (!next) break;
+        prev = t;
+        t = next;
+    }
+    return result;
+}
+
+static void MigrateSlot(ConcurrentTable *t, int addr) {
+    for (;;) {
+        uint64_t slot = LOAD(&t->slots[addr]);
+        int k = KeyOf(slot), v = ValueOf(slot);
+        if (v == CONCURRENT_MOVED) return;
+        // A tombstone still has to undo an earlier copy of its value
+        if (k != NULLKEY) {
+            StoreValue(LOAD(&t->next), k, v);
+        }
+        if (CAS(&t->slots[addr], &slot, Pack(k, CONCURRENT_MOVED))) return;
+    }
+}
+
+// Install the next table; only the root table starts a migration
+static void StartMigration(ConcurrentHashMap *map, ConcurrentTable *t) {
+    if (t != LOAD(&map->root) || LOAD(&t->next)) return;
+    int size = 2 * (LOAD(&map->count) + 1);
+    ConcurrentTable *next = NewTable(size < t->length ? t->length : size);
+    if (!next) return;
+    ConcurrentTable *expected = NULL;
+    if (!CAS(&t->next, &expected, next)) {
+        FreeTable(next);
+    }
+}
+
+// Migrate one chunk of the root table; 0 once every chunk is handed out
+static int HelpMigrate(ConcurrentHashMap *map, ConcurrentTable *t) {
+    // Look before adding: writers waiting on the last chunks call this in
+    // a loop, and unchecked adds would overflow migrateIndex. Past the
+    // check each thread adds at most one more chunk.
+    if (LOAD(&t->migrateIndex) >= t->length) return 0;
+    int start = __atomic_fetch_add(&t->migrateIndex, CONCURRENT_MIGRATE_CHUNK, __ATOMIC_RELAXED);
+    if (start >= t->length) return 0;
+    int end = start + CONCURRENT_MIGRATE_CHUNK < t->length ? start + CONCURRENT_MIGRATE_CHUNK : t->length;
+    for (int i = start; i < end; i++) {
+        MigrateSlot(t, i);
+    }
+    if (__atomic_add_fetch(&t->migrated, end - start, __ATOMIC_ACQ_REL) == t->length) {
+        __atomic_store_n(&map->root, LOAD(&t->next), __ATOMIC_RELEASE);
+        RetireTable(map, t);
+    }
+    return 1;
+}
+
+// Apply a write, helping any migration along by one chunk first; only a
+// write refused a slot keeps helping until there is room for it
+static int Update(ConcurrentHashMap *map, int thread, int key, int value) {
+    EnterEpoch(map, thread);
+    int result;
+    for (;;) {
+        ConcurrentTable *t = LOAD(&map->root);
+        if (LOAD(&t->next)) {
+            HelpMigrate(map, t);
+        }
+        result = StoreValue(LOAD(&map->root), key, value);
+        if (result != -1) break;
+        t = LOAD(&map->root);
+        if (LOAD(&t->next)) {
+            // The last chunks are in other hands: let them finish
+            if (!HelpMigrate(map, t)) sched_yield();
+        } else {
+            StartMigration(map, t);
+        }
+    }
+    ConcurrentTable *root = LOAD(&map->root);
+    if (LOAD(&root->claimed) > root->length / 4 * 3) {
+        StartMigration(map, root);
+    }
+    ExitEpoch(map, thread);
+    if (LOAD(&map->retiredCount) > 0) {
+        TryAdvanceEpoch(map);
+    }
+    return result;
+}
+
+int ConcurrentHashInit(ConcurrentHashMap *map, int size) {
+    map->root = NewTable(size);
+    map->count = 0;
+    map->globalEpoch = 0;
+    map->threadCount = 0;
+    for (int i = 0; i < CONCURRENT_MAX_THREADS; i++) {
+        map->threads[i].epoch = 0;
+        map->threads[i].active = 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        map->retired[i] = NULL;
+    }
+    map->retiredCount = 0;
+    pthread_mutex_init(&map->retireLock, NULL);
+    return map->root != NULL;
+}
+
+void ConcurrentHashDestroy(ConcurrentHashMap *map) {
+    if (map->root) {
+        if (map->root->next) FreeTable(map->root->next);
+        FreeTable(map->root);
+    }
+    for (int i = 0; i < 3; i++) {
+        while (map->retired[i]) {
+            ConcurrentTable *t = map->retired[i];
+            map->retired[i] = t->retiredNext;
+            FreeTable(t);
+        }
+    }
+    map->root = NULL;
+    map->retiredCount = 0;
+    pthread_mutex_destroy(&map->retireLock);
+}
+
+int ConcurrentHashRegister(ConcurrentHashMap *map) {
+    int thread = __atomic_fetch_add(&map->threadCount, 1, __ATOMIC_ACQ_REL);
+    return thread < CONCURRENT_MAX_THREADS ? thread : -1;
+}
+
+int ConcurrentHashFind(ConcurrentHashMap *map, int thread, int key, int *value) {
+    int found = 0;
+    EnterEpoch(map, thread);
+    ConcurrentTable *t = LOAD(&map->root);
+    while (t) {
+        int mask = t->length - 1;
+        int addr = (int)(Hash(key) & mask);
+        ConcurrentTable *next = NULL;
+        for (int i = 0; i < t->length; i++) {
+            uint64_t slot = LOAD(&t->slots[addr]);
+            int k = KeyOf(slot), v = ValueOf(slot);
+            if (k == key || k == NULLKEY) {
+                if (v == CONCURRENT_MOVED) {
+                    next = LOAD(&t->next);
+                } else if (k == key && v != CONCURRENT_TOMBSTONE) {
+                    *value = v;
+                    found = 1;
+                }
+                break;
+            }
+            addr = (addr + 1) & mask;
+        }
+        t = next;
+    }
+    ExitEpoch(map, thread);
+    return found;
+}
+
+int ConcurrentHashInsert(ConcurrentHashMap *map, int thread, int key, int value) {
+    if (key == NULLKEY || value == CONCURRENT_TOMBSTONE || value == CONCURRENT_MOVED) return 0;
+    if (Update(map, thread, key, value) == 0) {
+        __atomic_fetch_add(&map->count, 1, __ATOMIC_RELAXED);
+    }
+    return 1;
+}
+
+int ConcurrentHashDelete(ConcurrentHashMap *map, int thread, int key) {
+    if (key == NULLKEY) return 0;
+    if (Update(map, thread, key, CONCURRENT_TOMBSTONE) != 1) return 0;
+    __atomic_fetch_sub(&map->count, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+int ConcurrentHashCount(ConcurrentHashMap *map) {
+    return LOAD(&map->count);
+}
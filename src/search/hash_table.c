@@ -2,52 +2,296 @@
 #include <stdlib.h>
 #include "include/search/hash_table.h"
 
-int Hash(int key) {
-    return key % 13;
+/*
+ * Open addressing with linear probing
+ *
+ * Keys are mixed with the murmur3 finalizer, so the low bits of the hash
+ * pick a slot of a power-of-two table even for keys with a common stride.
+ * When keys and tombstones pass 3/4 of the table, a new array is made and
+ * every insert or delete migrates HASH_REHASH_STEP slots of the old one,
+ * so no single operation pays for the whole rehash; lookups check the new
+ * array first and then the old one. The new array is never smaller than
+ * the old one and at most half full, so it cannot fill up before the
+ * migration ends. Deleting the last key of a probe chain empties its slot
+ * together with the tombstones before it; the rest go at the next rehash.
+ *
+ * In Robin Hood mode every slot records how far its key is from home. An
+ * insert that meets a key closer to home than itself takes that slot and
+ * carries the displaced key on, which keeps probe lengths close to the
+ * average; a lookup stops as soon as it meets such a key. Deletion shifts
+ * the rest of the cluster back by one slot instead of leaving a tombstone,
+ * so elem never holds DELKEY. Keys still in oldElem are deleted with
+ * tombstones, which go away with oldElem.
+ *
+ * On a table much larger than the cache nearly every lookup waits on a
+ * memory miss for its home slot. SearchHashBatch hashes a block of keys
+ * first and prefetches the home slot of the key HASH_PREFETCH_DISTANCE
+ * places ahead before probing the current one, so several misses are in
+ * flight at once instead of one after another.
+ */
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+unsigned int Hash(int key) {
+    unsigned int h = (unsigned int)key;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int RoundLength(int size) {
+    int length = HASH_MIN_LENGTH;
+    while (length < size && length < (1 << 30)) {
+        length <<= 1;
+    }
+    return length;
+}
+
+static int *NewSlots(int length) {
+    int *elem = (int *)malloc(length * sizeof(int));
+    if (elem) {
+        for (int i = 0; i < length; i++) {
+            elem[i] = NULLKEY;
+        }
+    }
+    return elem;
+}
+
+// Slot holding key, or -1 once the probe reaches an empty slot
+static int Probe(const int *elem, int length, int key, unsigned int hash) {
+    int mask = length - 1;
+    int addr = (int)(hash & mask);
+    for (int i = 0; i < length && elem[addr] != NULLKEY; i++) {
+        if (elem[addr] == key) return addr;
+        addr = (addr + 1) & mask;
+    }
+    return -1;
+}
+
+// Robin Hood lookup: a key nearer its home than we are to ours ends the probe
+static int ProbeRobinHood(const int *elem, const int *dist, int length, int key, unsigned int hash) {
+    int mask = length - 1;
+    int addr = (int)(hash & mask);
+    for (int d = 1; d <= dist[addr]; d++) {
+        if (elem[addr] == key) return addr;
+        addr = (addr + 1) & mask;
+    }
+    return -1;
+}
+
+static int PlaceRobinHood(HashTable *H, int key) {
+    int mask = H->length - 1;
+    int addr = (int)(Hash(key) & mask);
+    int d = 1;
+    for (int i = 0; i < H->length; i++) {
+        if (H->elem[addr] == NULLKEY) {
+            H->elem[addr] = key;
+            H->dist[addr] = d;
+            H->used++;
+            return 1;
+        }
+        if (H->dist[addr] < d) {
+            int resident = H->elem[addr], residentDist = H->dist[addr];
+            H->elem[addr] = key;
+            H->dist[addr] = d;
+            key = resident;
+            d = residentDist;
+        }
+        addr = (addr + 1) & mask;
+        d++;
+    }
+    return 0;
+}
+
+// Close the gap at addr by moving the cluster behind it one slot back
+static void ShiftBack(HashTable *H, int addr) {
+    int mask = H->length - 1;
+    int next = (addr + 1) & mask;
+    while (H->dist[next] > 1) {
+        H->elem[addr] = H->elem[next];
+        H->dist[addr] = H->dist[next] - 1;
+        addr = next;
+        next = (next + 1) & mask;
+    }
+    H->elem[addr] = NULLKEY;
+    H->dist[addr] = 0;
+    H->used--;
+}
+
+// Store a key known to be absent in the first free slot of its probe chain
+static int PlaceKey(HashTable *H, int key) {
+    if (H->dist) return PlaceRobinHood(H, key);
+    int mask = H->length - 1;
+    int addr = (int)(Hash(key) & mask);
+    for (int i = 0; i < H->length; i++) {
+        if (H->elem[addr] == NULLKEY || H->elem[addr] == DELKEY) {
+            if (H->elem[addr] == NULLKEY) H->used++;
+            H->elem[addr] = key;
+            return 1;
+        }
+        addr = (addr + 1) & mask;
+    }
+    return 0;
+}
+
+// Move up to steps slots of oldElem; migrated slots become tombstones so
+// that chains of keys still waiting in oldElem stay intact
+static void MigrateSlots(HashTable *H, int steps) {
+    while (H->oldElem && steps-- > 0) {
+        int key = H->oldElem[H->rehashIndex];
+        if (key != NULLKEY && key != DELKEY) {
+            PlaceKey(H, key);
+            H->oldElem[H->rehashIndex] = DELKEY;
+        }
+        if (++H->rehashIndex == H->oldLength) {
+            free(H->oldElem);
+            H->oldElem = NULL;
+            H->oldLength = 0;
+        }
+    }
+}
+
+static void StartRehash(HashTable *H) {
+    MigrateSlots(H, H->oldLength);
+    int length = RoundLength(2 * (H->count + 1));
+    if (length < H->length) length = H->length;
+    int *elem = NewSlots(length);
+    if (!elem) return;
+    if (H->dist) {
+        int *dist = (int *)calloc(length, sizeof(int));
+        if (!dist) {
+            free(elem);
+            return;
+        }
+        free(H->dist);
+        H->dist = dist;
+    }
+    H->oldElem = H->elem;
+    H->oldLength = H->length;
+    H->rehashIndex = 0;
+    H->elem = elem;
+    H->length = length;
+    H->used = 0;
 }
 
 void InitHashTable(HashTable *H, int size) {
     H->count = 0;
-    H->length = size;
-    H->elem = (int *)malloc(size * sizeof(int));
-    for (int i = 0; i < size; i++) {
-        H->elem[i] = NULLKEY;
+    H->length = RoundLength(size);
+    H->used = 0;
+    H->elem = NewSlots(H->length);
+    H->oldElem = NULL;
+    H->oldLength = 0;
+    H->rehashIndex = 0;
+    H->dist = NULL;
+}
+
+void InitRobinHoodHashTable(HashTable *H, int size) {
+    InitHashTable(H, size);
+    H->dist = (int *)calloc(H->length, sizeof(int));
+}
+
+void DestroyHashTable(HashTable *H) {
+    free(H->elem);
+    free(H->oldElem);
+    free(H->dist);
+    H->elem = NULL;
+    H->oldElem = NULL;
+    H->dist = NULL;
+    H->count = 0;
+    H->length = 0;
+    H->used = 0;
+    H->oldLength = 0;
+}
+
+// SearchHash with the hash of key already known
+static int Lookup(const HashTable *H, int key, unsigned int hash) {
+    if (key == NULLKEY || key == DELKEY) return -1;
+    int addr = H->dist ? ProbeRobinHood(H->elem, H->dist, H->length, key, hash) :
+                         Probe(H->elem, H->length, key, hash);
+    if (addr != -1) return addr;
+    if (H->oldElem) {
+        addr = Probe(H->oldElem, H->oldLength, key, hash);
+        if (addr != -1) return H->length + addr;
     }
+    return -1;
 }
 
 int SearchHash(HashTable H, int key) {
-    int addr = Hash(key);
-    while (H.elem[addr] != key && H.elem[addr] != NULLKEY) {
-        addr = (addr + 1) % H.length;
-    }
-    if (H.elem[addr] == key) {
-        return addr;
-    } else {
-        return -1;
+    return Lookup(&H, key, Hash(key));
+}
+
+int SearchHashBatch(const HashTable *H, const int *keys, int n, int *out) {
+    unsigned int hashes[HASH_BATCH];
+    unsigned int mask = H->length - 1;
+    int found = 0;
+    for (int base = 0; base < n; base += HASH_BATCH) {
+        int size = n - base < HASH_BATCH ? n - base : HASH_BATCH;
+        for (int i = 0; i < size; i++) {
+            hashes[i] = Hash(keys[base + i]);
+        }
+        for (int i = 0; i < size && i < HASH_PREFETCH_DISTANCE; i++) {
+            PREFETCH(&H->elem[hashes[i] & mask]);
+            if (H->dist) PREFETCH(&H->dist[hashes[i] & mask]);
+        }
+        for (int i = 0; i < size; i++) {
+            if (i + HASH_PREFETCH_DISTANCE < size) {
+                unsigned int addr = hashes[i + HASH_PREFETCH_DISTANCE] & mask;
+                PREFETCH(&H->elem[addr]);
+                if (H->dist) PREFETCH(&H->dist[addr]);
+            }
+            out[base + i] = Lookup(H, keys[base + i], hashes[i]);
+            found += out[base + i] != -1;
+        }
     }
+    return found;
 }
 
 int InsertHash(HashTable *H, int key) {
-    int addr = Hash(key);
-    while (H->elem[addr] != NULLKEY && H->elem[addr] != DELKEY) {
-        addr = (addr + 1) % H->length;
+    if (SearchHash(*H, key) != -1 || key == NULLKEY || key == DELKEY) {
+        return 0;
     }
-    if (H->elem[addr] == DELKEY || H->elem[addr] == NULLKEY) {
-        H->elem[addr] = key;
-        H->count++;
-        return 1;
+    if (H->used + 1 > H->length / 4 * 3) {
+        StartRehash(H);
     }
-    return 0;
+    MigrateSlots(H, HASH_REHASH_STEP);
+    if (!PlaceKey(H, key)) {
+        return 0;
+    }
+    H->count++;
+    return 1;
 }
 
 int DeleteHash(HashTable *H, int key) {
     int addr = SearchHash(*H, key);
-    if (addr != -1) {
+    if (addr == -1) {
+        return 0;
+    }
+    if (addr >= H->length) {
+        H->oldElem[addr - H->length] = DELKEY;
+    } else if (H->dist) {
+        ShiftBack(H, addr);
+    } else {
+        int mask = H->length - 1;
         H->elem[addr] = DELKEY;
-        H->count--;
-        return 1;
+        // Nothing probes past an empty slot, so trailing tombstones can go
+        if (H->elem[(addr + 1) & mask] == NULLKEY) {
+            while (H->elem[addr] == DELKEY) {
+                H->elem[addr] = NULLKEY;
+                H->used--;
+                addr = (addr - 1) & mask;
+            }
+        }
     }
-    return 0;
+    H->count--;
+    MigrateSlots(H, HASH_REHASH_STEP);
+    return 1;
 }
 
 void PrintHashTable(HashTable H) {
@@ -57,4 +301,9 @@ void PrintHashTable(HashTable H) {
             printf("[%d] = %d\n", i, H.elem[i]);
         }
     }
+    for (int i = 0; i < H.oldLength; i++) {
+        if (H.oldElem[i] != NULLKEY && H.oldElem[i] != DELKEY) {
+            printf("[old %d] = %d\n", i, H.oldElem[i]);
+        }
+    }
 }
@@ -0,0 +1,284 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/search/swiss_map.h"
+
+/*
+ * Swiss table
+ *
+ * The hash splits into h1, which picks where probing starts, and h2, the
+ * 7 bits kept in the control byte. A probe loads 16 control bytes at once
+ * and compares them with h2 in one SSE2 instruction; only the few slots
+ * whose byte matches have their key compared, and a group holding an
+ * empty byte ends the probe. Groups are visited in triangular steps,
+ * which reach every group of a power-of-two table. The first 15 control
+ * bytes are copied past the end so that a group starting near the end
+ * can be loaded without wrapping. The table is kept at most 7/8 full.
+ */
+
+#define SWISS_EMPTY ((signed char)-128)
+#define SWISS_DELETED ((signed char)-2)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SWISS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Bit i set when control byte i of the group equals c
+static unsigned MatchByte(const signed char *group, signed char c) {
+#ifdef SWISS_SSE2
+    __m128i g = _mm_loadu_si128((const __m128i *)group);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < SWISS_GROUP; i++) {
+        mask |= (unsigned)(group[i] == c) << i;
+    }
+    return mask;
+#endif
+}
+
+// Empty and deleted bytes are the negative ones
+static unsigned MatchEmptyOrDeleted(const signed char *group) {
+#ifdef SWISS_SSE2
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < SWISS_GROUP; i++) {
+        mask |= (unsigned)(group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+static int TrailingZeros(unsigned mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int n = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Leading zeros of a 16-bit group mask
+static int LeadingZeros16(unsigned mask) {
+    int n = 0;
+    for (unsigned bit = 1u << (SWISS_GROUP - 1); bit && !(mask & bit); bit >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+static uint64_t Mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t HashKey(const void *key, size_t size) {
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t chunk;
+    // Int and pointer-sized keys skip the loop and the variable-length copy
+    switch (size) {
+        case 4: {
+            uint32_t k;
+            memcpy(&k, p, 4);
+            return Mix64(h ^ k);
+        }
+        case 8:
+            memcpy(&chunk, p, 8);
+            return Mix64(h ^ chunk);
+        default:
+            break;
+    }
+    for (; size >= 8; p += 8, size -= 8) {
+        memcpy(&chunk, p, 8);
+        h = (h ^ chunk) * 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 29;
+    }
+    if (size > 0) {
+        chunk = 0;
+        memcpy(&chunk, p, size);
+        h ^= chunk;
+    }
+    return Mix64(h);
+}
+
+static int KeyEqual(const char *x, const void *y, size_t size) {
+    switch (size) {
+        case 4: {
+            uint32_t a, b;
+            memcpy(&a, x, 4);
+            memcpy(&b, y, 4);
+            return a == b;
+        }
+        case 8: {
+            uint64_t a, b;
+            memcpy(&a, x, 8);
+            memcpy(&b, y, 8);
+            return a == b;
+        }
+        default:
+            return memcmp(x, y, size) == 0;
+    }
+}
+
+static void SetCtrl(SwissMap *map, size_t i, signed char c) {
+    map->ctrl[i] = c;
+    if (i < SWISS_GROUP - 1) {
+        map->ctrl[map->capacity + i] = c;
+    }
+}
+
+// Slot of key, or map->capacity when it is absent
+static size_t FindSlot(const SwissMap *map, const void *key, uint64_t hash) {
+    size_t mask = map->capacity - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    signed char h2 = (signed char)(hash & 0x7f);
+    for (size_t step = SWISS_GROUP;; step += SWISS_GROUP) {
+        const signed char *group = map->ctrl + pos;
+        for (unsigned m = MatchByte(group, h2); m; m &= m - 1) {
+            size_t slot = (pos + TrailingZeros(m)) & mask;
+            if (KeyEqual(map->keys + slot * map->keySize, key, map->keySize)) return slot;
+        }
+        if (MatchByte(group, SWISS_EMPTY)) return map->capacity;
+        pos = (pos + step) & mask;
+    }
+}
+
+// First empty or deleted slot on the probe sequence of hash
+static size_t FindFreeSlot(const SwissMap *map, uint64_t hash) {
+    size_t mask = map->capacity - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    for (size_t step = SWISS_GROUP;; step += SWISS_GROUP) {
+        unsigned m = MatchEmptyOrDeleted(map->ctrl + pos);
+        if (m) return (pos + TrailingZeros(m)) & mask;
+        pos = (pos + step) & mask;
+    }
+}
+
+static int AllocSlots(SwissMap *map, size_t capacity) {
+    size_t valueBytes = capacity * map->valueSize;
+    map->ctrl = (signed char *)malloc(capacity + SWISS_GROUP);
+    map->keys = (char *)malloc(capacity * map->keySize);
+    map->values = (char *)malloc(valueBytes ? valueBytes : 1);
+    if (!map->ctrl || !map->keys || !map->values) {
+        free(map->ctrl);
+        free(map->keys);
+        free(map->values);
+        return 0;
+    }
+    memset(map->ctrl, SWISS_EMPTY, capacity + SWISS_GROUP);
+    map->capacity = capacity;
+    map->growthLeft = capacity - capacity / 8 - map->count;
+    return 1;
+}
+
+// Move every entry into a table of the given capacity, dropping tombstones
+static int Rehash(SwissMap *map, size_t capacity) {
+    SwissMap old = *map;
+    if (!AllocSlots(map, capacity)) {
+        *map = old;
+        return 0;
+    }
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] < 0) continue;
+        const char *key = old.keys + i * old.keySize;
+        uint64_t hash = HashKey(key, old.keySize);
+        size_t slot = FindFreeSlot(map, hash);
+        SetCtrl(map, slot, (signed char)(hash & 0x7f));
+        memcpy(map->keys + slot * map->keySize, key, map->keySize);
+        memcpy(map->values + slot * map->valueSize, old.values + i * old.valueSize, map->valueSize);
+    }
+    free(old.ctrl);
+    free(old.keys);
+    free(old.values);
+    return 1;
+}
+
+int SwissMapInit(SwissMap *map, size_t keySize, size_t valueSize, size_t capacity) {
+    size_t length = SWISS_MIN_CAPACITY;
+    while (length - length / 8 < capacity) {
+        length <<= 1;
+    }
+    map->keySize = keySize;
+    map->valueSize = valueSize;
+    map->count = 0;
+    return keySize > 0 && AllocSlots(map, length);
+}
+
+void SwissMapDestroy(SwissMap *map) {
+    free(map->ctrl);
+    free(map->keys);
+    free(map->values);
+    map->ctrl = NULL;
+    map->keys = NULL;
+    map->values = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->growthLeft = 0;
+}
+
+int SwissMapInsert(SwissMap *map, const void *key, const void *value) {
+    uint64_t hash = HashKey(key, map->keySize);
+    size_t slot = FindSlot(map, key, hash);
+    if (slot == map->capacity) {
+        slot = FindFreeSlot(map, hash);
+        if (map->growthLeft == 0 && map->ctrl[slot] == SWISS_EMPTY) {
+            // Mostly tombstones: rebuild at the same capacity, otherwise
+            // double; Rehash copies into new arrays either way, so the old
+            // and new tables are both allocated until it returns
+            size_t capacity = map->count < map->capacity / 2 - map->capacity / 16 ?
+                              map->capacity : 2 * map->capacity;
+            if (!Rehash(map, capacity)) return 0;
+            slot = FindFreeSlot(map, hash);
+        }
+        if (map->ctrl[slot] == SWISS_EMPTY) map->growthLeft--;
+        SetCtrl(map, slot, (signed char)(hash & 0x7f));
+        memcpy(map->keys + slot * map->keySize, key, map->keySize);
+        map->count++;
+    }
+    memcpy(map->values + slot * map->valueSize, value, map->valueSize);
+    return 1;
+}
+
+void *SwissMapFind(const SwissMap *map, const void *key) {
+    size_t slot = FindSlot(map, key, HashKey(key, map->keySize));
+    return slot == map->capacity ? NULL : map->values + slot * map->valueSize;
+}
+
+int SwissMapErase(SwissMap *map, const void *key) {
+    size_t slot = FindSlot(map, key, HashKey(key, map->keySize));
+    if (slot == map->capacity) return 0;
+
+    // If every 16-slot window through the slot also holds an empty byte,
+    // no probe ever went past it and the slot can become empty again
+    size_t mask = map->capacity - 1;
+    unsigned after = MatchByte(map->ctrl + slot, SWISS_EMPTY);
+    unsigned before = MatchByte(map->ctrl + ((slot - SWISS_GROUP) & mask), SWISS_EMPTY);
+    int neverFull = after && before && TrailingZeros(after) + LeadingZeros16(before) < SWISS_GROUP;
+    SetCtrl(map, slot, neverFull ? SWISS_EMPTY : SWISS_DELETED);
+    if (neverFull) map->growthLeft++;
+    map->count--;
+    return 1;
+}
+
+int SwissMapNext(const SwissMap *map, size_t *iter, const void **key, void **value) {
+    while (*iter < map->capacity) {
+        size_t i = (*iter)++;
+        if (map->ctrl[i] >= 0) {
+            *key = map->keys + i * map->keySize;
+            *value = map->values + i * map->valueSize;
+            return 1;
+        }
+    }
+    return 0;
+}
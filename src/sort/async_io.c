@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "include/sort/async_io.h"
+
+/*
+ * Asynchronous file I/O
+ *
+ * The thread backend hands requests to a single worker through a FIFO
+ * protected by a mutex; the worker runs plain fread/fwrite, so requests
+ * on the same file complete in order and need no offsets. The io_uring
+ * backend talks to the kernel through the raw syscalls and two shared
+ * rings, so no liburing is needed: a request becomes one READ or WRITE
+ * entry at its file offset, and short transfers are resubmitted for the
+ * remainder until they reach end of file.
+ */
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING_SUPPORTED 1
+#include <errno.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+#define URING_ENTRIES 1024
+#define URING_MAX_TRANSFER (1u << 30)
+
+struct AsyncIo {
+    AsyncIoBackend backend;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    AsyncRequest *head, *tail;
+    int shutdown;
+
+#ifdef ASYNC_IO_URING_SUPPORTED
+    int ring;
+    void *sqMap, *cqMap;
+    size_t sqMapSize, cqMapSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray, sqEntries;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+// Run one request to completion with stdio
+static void TransferBlocking(AsyncRequest *req) {
+    while (req->done < req->bytes) {
+        size_t n = req->write
+            ? fwrite(req->buffer + req->done, 1, req->bytes - req->done, req->file)
+            : fread(req->buffer + req->done, 1, req->bytes - req->done, req->file);
+        if (n == 0) {
+            req->error = ferror(req->file) != 0;
+            break;
+        }
+        req->done += n;
+    }
+}
+
+static void *IoWorker(void *arg) {
+    AsyncIo *io = (AsyncIo *)arg;
+    pthread_mutex_lock(&io->lock);
+    for (;;) {
+        while (!io->head && !io->shutdown) {
+            pthread_cond_wait(&io->work, &io->lock);
+        }
+        if (!io->head) break;
+        AsyncRequest *req = io->head;
+        io->head = req->next;
+        if (!io->head) io->tail = NULL;
+        pthread_mutex_unlock(&io->lock);
+
+        TransferBlocking(req);
+
+        pthread_mutex_lock(&io->lock);
+        req->complete = 1;
+        pthread_cond_broadcast(&io->done);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+
+#ifdef ASYNC_IO_URING_SUPPORTED
+
+static int UringEnter(AsyncIo *io, unsigned submit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, io->ring, submit, minComplete, flags, NULL, 0);
+}
+
+static int UringSetup(AsyncIo *io) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    io->ring = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (io->ring < 0) return 0;
+
+    io->sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    io->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (io->cqMapSize > io->sqMapSize) io->sqMapSize = io->cqMapSize;
+        io->cqMapSize = io->sqMapSize;
+    }
+    io->sqMap = mmap(NULL, io->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     io->ring, IORING_OFF_SQ_RING);
+    io->cqMap = single ? io->sqMap
+                       : mmap(NULL, io->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              io->ring, IORING_OFF_CQ_RING);
+    io->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = (struct io_uring_sqe *)mmap(NULL, io->sqesSize, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_SQES);
+    if (io->sqMap == MAP_FAILED || io->cqMap == MAP_FAILED || io->sqes == MAP_FAILED) {
+        if (io->sqMap != MAP_FAILED) munmap(io->sqMap, io->sqMapSize);
+        if (!single && io->cqMap != MAP_FAILED) munmap(io->cqMap, io->cqMapSize);
+        if (io->sqes != MAP_FAILED) munmap(io->sqes, io->sqesSize);
+        close(io->ring);
+        return 0;
+    }
+
+    char *sq = (char *)io->sqMap, *cq = (char *)io->cqMap;
+    io->sqHead = (unsigned *)(sq + p.sq_off.head);
+    io->sqTail = (unsigned *)(sq + p.sq_off.tail);
+    io->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+    io->sqArray = (unsigned *)(sq + p.sq_off.array);
+    io->sqEntries = p.sq_entries;
+    io->cqHead = (unsigned *)(cq + p.cq_off.head);
+    io->cqTail = (unsigned *)(cq + p.cq_off.tail);
+    io->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 1;
+}
+
+static void UringTeardown(AsyncIo *io) {
+    munmap(io->sqes, io->sqesSize);
+    if (io->cqMap != io->sqMap) munmap(io->cqMap, io->cqMapSize);
+    munmap(io->sqMap, io->sqMapSize);
+    close(io->ring);
+}
+
+// Queue the untransferred part of req and submit it to the kernel
+static void UringPush(AsyncIo *io, AsyncRequest *req) {
+    unsigned tail = *io->sqTail;
+    while (tail - __atomic_load_n(io->sqHead, __ATOMIC_ACQUIRE) == io->sqEntries) {
+        UringEnter(io, 0, 0, 0);
+    }
+    unsigned index = tail & *io->sqMask;
+    struct io_uring_sqe *sqe = &io->sqes[index];
+    size_t length = req->bytes - req->done;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fileno(req->file);
+    sqe->addr = (uint64_t)(uintptr_t)(req->buffer + req->done);
+    sqe->len = length > URING_MAX_TRANSFER ? URING_MAX_TRANSFER : (unsigned)length;
+    sqe->off = (uint64_t)(req->offset + (long long)req->done);
+    sqe->user_data = (uint64_t)(uintptr_t)req;
+    io->sqArray[index] = index;
+    __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    while (UringEnter(io, 1, 0, 0) < 0 && errno == EINTR) {
+    }
+}
+
+// Handle every completion in the ring
+static void UringReap(AsyncIo *io) {
+    unsigned head = *io->cqHead;
+    unsigned tail = __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &io->cqes[head & *io->cqMask];
+        AsyncRequest *req = (AsyncRequest *)(uintptr_t)cqe->user_data;
+        int result = cqe->res;
+        head++;
+        __atomic_store_n(io->cqHead, head, __ATOMIC_RELEASE);
+
+        if (result == -EAGAIN || result == -EINTR) {
+            UringPush(io, req);
+        } else if (result < 0) {
+            req->error = 1;
+            req->complete = 1;
+        } else if (result == 0 || req->done + result >= req->bytes) {
+            req->done += result;
+            req->complete = 1;
+        } else {
+            req->done += result;
+            UringPush(io, req);
+        }
+        tail = __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE);
+    }
+}
+
+#endif
+
+AsyncIo *AsyncIoCreate(AsyncIoBackend backend) {
+    AsyncIo *io = (AsyncIo *)calloc(1, sizeof(AsyncIo));
+    if (!io) return NULL;
+
+#ifdef ASYNC_IO_URING_SUPPORTED
+    if (backend == ASYNC_IO_URING && UringSetup(io)) {
+        io->backend = ASYNC_IO_URING;
+        return io;
+    }
+#else
+    (void)backend;
+#endif
+
+    io->backend = ASYNC_IO_THREAD;
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->work, NULL);
+    pthread_cond_init(&io->done, NULL);
+    if (pthread_create(&io->thread, NULL, IoWorker, io) != 0) {
+        pthread_mutex_destroy(&io->lock);
+        pthread_cond_destroy(&io->work);
+        pthread_cond_destroy(&io->done);
+        free(io);
+        return NULL;
+    }
+    return io;
+}
+
+AsyncIoBackend AsyncIoGetBackend(const AsyncIo *io) {
+    return io->backend;
+}
+
+void AsyncIoDestroy(AsyncIo *io) {
+    if (!io) return;
+#ifdef ASYNC_IO_URING_SUPPORTED
+    if (io->backend == ASYNC_IO_URING) {
+        UringTeardown(io);
+        free(io);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    io->shutdown = 1;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+    pthread_join(io->thread, NULL);
+    pthread_mutex_destroy(&io->lock);
+    pthread_cond_destroy(&io->work);
+    pthread_cond_destroy(&io->done);
+    free(io);
+}
+
+void AsyncIoSubmit(AsyncIo *io, AsyncRequest *req, FILE *file, void *buffer, size_t bytes,
+                   long long offset, int write) {
+    req->file = file;
+    req->buffer = (char *)buffer;
+    req->bytes = bytes;
+    req->offset = offset;
+    req->write = write;
+    req->done = 0;
+    req->complete = bytes == 0;
+    req->error = 0;
+    req->next = NULL;
+    if (req->complete) return;
+
+#ifdef ASYNC_IO_URING_SUPPORTED
+    if (io->backend == ASYNC_IO_URING) {
+        UringPush(io, req);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    if (io->tail) {
+        io->tail->next = req;
+    } else {
+        io->head = req;
+    }
+    io->tail = req;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+}
+
+size_t AsyncIoWait(AsyncIo *io, AsyncRequest *req) {
+#ifdef ASYNC_IO_URING_SUPPORTED
+    if (io->backend == ASYNC_IO_URING) {
+        for (;;) {
+            UringReap(io);
+            if (req->complete) break;
+            UringEnter(io, 0, 1, IORING_ENTER_GETEVENTS);
+        }
+        return req->done;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    while (!req->complete) {
+        pthread_cond_wait(&io->done, &io->lock);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return req->done;
+}
@@ -1,13 +1,15 @@
 #include "include/sort/bubble_sort.h"
+#include "include/sort/sort_stats.h"
 
 void BubbleSort(int *a, int n) {
     for (int i = 0; i < n - 1; i++) {
         int flag = 0;
         for (int j = 0; j < n - 1 - i; j++) {
-            if (a[j] > a[j + 1]) {
+            if (SORT_CMP(a[j] > a[j + 1])) {
                 int temp = a[j];
                 a[j] = a[j + 1];
                 a[j + 1] = temp;
+                SORT_MOVES(2);
                 flag = 1;
             }
         }
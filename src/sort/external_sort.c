@@ -10,14 +10,54 @@
  * Space Complexity: O(M) where M is memory buffer size
  *
  * This implementation uses:
- * - Quick sort for in-memory sorting
- * - K-way merge for combining sorted runs
+ * - Quick sort or replacement selection for run generation
+ * - Loser tree K-way merge for combining sorted runs
  * - Buffering to minimize disk I/O
+ *
+ * ExternalSortEx sizes every buffer from a memory budget and, when there
+ * are more runs than the fan-in allows, merges them in several passes.
+ * In pipelined mode every buffer has a twin: a background I/O thread (or
+ * io_uring) fills or drains one while the sort works on the other.
+ * With several threads, chunks are sorted concurrently and each merge is
+ * cut by splitter keys into key ranges that threads merge independently,
+ * writing their slice of the output at its final offset.
+ * The mmap mode copies each chunk from the mapped input straight into a
+ * mapped run file and sorts it there, merges from mapped runs into a
+ * mapped output, and drops pages behind the merge with madvise.
+ * Compressed runs are written as delta-encoded blocks (run_codec.h) and
+ * decoded as the merge reads them, trading CPU for run file I/O.
+ * Every ExternalSortEx job keeps its runs in its own directory. A named
+ * job directory also holds a manifest of finished runs and merges, so a
+ * sort that crashed resumes where it stopped.
+ * ExternalSortRecords sorts fixed-size records or text lines by a byte
+ * key. Chunks are sorted as an index of key prefixes and record pointers;
+ * runs store whole records, so payloads stay next to their keys.
  */
 
 #include "../../include/sort/external_sort.h"
+#include "../../include/sort/async_io.h"
+#include "../../include/sort/quick_sort.h"
+#include "../../include/sort/run_codec.h"
+#include "../../include/sort/sort_ex.h"
+#include "../../include/sort/simd_sort.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define EXTERNAL_SORT_MMAP 1
+#include <sys/mman.h>
+#endif
 
 /**
  * Partition function for quick sort
@@ -50,13 +90,18 @@ int PartitionExternal(int arr[], int low, int high) {
 
 /**
  * Quick sort implementation for external sorting
- * Sorts array in place using divide and conquer
+ * Sorts array in place using divide and conquer;
+ * small partitions are finished with the SIMD sorting network
  *
  * @param arr Array to sort
  * @param low Starting index
  * @param high Ending index
  */
 void QuickSortExternal(int arr[], int low, int high) {
+    if (high - low + 1 <= SIMD_BLOCK_MAX) {
+        SortingNetwork(arr + low, high - low + 1);
+        return;
+    }
     if (low < high) {
         int pi = PartitionExternal(arr, low, high);
         QuickSortExternal(arr, low, pi - 1);
@@ -64,267 +109,2496 @@ void QuickSortExternal(int arr[], int low, int high) {
     }
 }
 
+ExternalSortStats externalSortStats;
+
+static RunGeneration runGeneration = RUNS_QUICKSORT;
+
+void ResetExternalSortStats(void) {
+    memset(&externalSortStats, 0, sizeof(externalSortStats));
+}
+
+static double PhaseClock(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 /**
- * Phase 1: Create initial sorted runs
- * Reads data from input file, sorts chunks in memory,
- * and writes them to temporary run files
+ * Close the run generation phase: what has been read and written so far
+ * belongs to it, the rest of the counters to the merge phase
  *
- * @param inputFile Path to input file
- * @return Number of runs created, or -1 on error
+ * @param start PhaseClock() at the start of run generation
+ * @return PhaseClock() at the start of the merge phase
  */
-int CreateRuns(const char *inputFile) {
-    FILE *input = fopen(inputFile, "r");
-    if (!input) {
-        printf("Cannot open input file: %s\n", inputFile);
-        return -1;
-    }
+static double EndRunPhase(double start) {
+    double now = PhaseClock();
+    externalSortStats.runBytesRead = externalSortStats.bytesRead;
+    externalSortStats.runBytesWritten = externalSortStats.bytesWritten;
+    externalSortStats.runSeconds = now - start;
+    return now;
+}
 
-    int runCount = 0;
-    int buffer[MEMORY_BUFFER];
-    int count;
+void ExternalSortSetRunGeneration(RunGeneration mode) {
+    runGeneration = mode;
+}
 
-    // Read file in chunks, sort each chunk, write to run file
-    while ((count = fread(buffer, sizeof(int), MEMORY_BUFFER, input)) > 0) {
-        QuickSortExternal(buffer, 0, count - 1);
+// Counters are shared by the sorting and merging threads
+#ifdef __GNUC__
+#define STATS_ADD(field, n) __atomic_fetch_add(&externalSortStats.field, (long long)(n), __ATOMIC_RELAXED)
+#else
+#define STATS_ADD(field, n) (externalSortStats.field += (long long)(n))
+#endif
 
-        char filename[100];
-        sprintf(filename, "run_%d.tmp", runCount);
-        FILE *runFile = fopen(filename, "w");
-        if (!runFile) {
-            printf("Cannot create run file: %s\n", filename);
-            fclose(input);
-            return -1;
-        }
+#ifdef _WIN32
+#define SeekFile _fseeki64
+#define TellFile _ftelli64
+#else
+#define SeekFile fseeko
+#define TellFile ftello
+#endif
 
-        fwrite(buffer, sizeof(int), count, runFile);
-        fclose(runFile);
+// fread/fwrite of ints that keep the I/O byte counters up to date
+static size_t ReadInts(int *buffer, size_t count, FILE *file) {
+    size_t n = fread(buffer, sizeof(int), count, file);
+    STATS_ADD(bytesRead, n * sizeof(int));
+    return n;
+}
 
-        runCount++;
+static size_t WriteInts(const int *buffer, size_t count, FILE *file) {
+    size_t n = fwrite(buffer, sizeof(int), count, file);
+    STATS_ADD(bytesWritten, n * sizeof(int));
+    return n;
+}
+
+// Write values as RunCodec blocks; returns 1 if everything was written
+static int WriteEncodedInts(const int *buffer, size_t count, FILE *file) {
+    unsigned char block[RUN_CODEC_MAX_BYTES];
+    for (size_t i = 0; i < count; i += RUN_CODEC_BLOCK) {
+        int n = count - i < RUN_CODEC_BLOCK ? (int)(count - i) : RUN_CODEC_BLOCK;
+        int bytes = RunCodecEncodeBlock(buffer + i, n, block);
+        if (fwrite(block, 1, bytes, file) != (size_t)bytes) {
+            return 0;
+        }
+        STATS_ADD(bytesWritten, bytes);
+        STATS_ADD(encodedValues, n);
+        STATS_ADD(encodedBytes, bytes);
     }
+    return 1;
+}
 
-    fclose(input);
-    return runCount;
+// Decode whole blocks into buffer while another block is sure to fit;
+// sets *error on a bad header, a truncated block or a read error
+static int ReadEncodedInts(int *buffer, int capacity, FILE *file, int *error) {
+    unsigned char block[RUN_CODEC_MAX_BYTES];
+    int count = 0;
+    while (capacity - count >= RUN_CODEC_BLOCK) {
+        size_t got = fread(block, 1, RUN_CODEC_HEADER, file);
+        if (got != RUN_CODEC_HEADER) {
+            if (got > 0 || ferror(file)) {
+                *error = 1;
+            }
+            break;
+        }
+        int bytes = RunCodecBlockBytes(block);
+        if (bytes < 0) {
+            *error = 1;
+            break;
+        }
+        size_t rest = (size_t)(bytes - RUN_CODEC_HEADER);
+        if (fread(block + RUN_CODEC_HEADER, 1, rest, file) != rest) {
+            *error = 1;
+            break;
+        }
+        STATS_ADD(bytesRead, bytes);
+        count += RunCodecDecodeBlock(block, buffer + count);
+    }
+    return count;
+}
+
+#ifdef _WIN32
+static pthread_mutex_t writeAtLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// Write at a file offset without moving a shared file position (pwrite)
+static size_t WriteIntsAt(const int *buffer, size_t count, FILE *file, long long offset) {
+    size_t bytes = count * sizeof(int);
+#ifdef _WIN32
+    pthread_mutex_lock(&writeAtLock);
+    SeekFile(file, offset, SEEK_SET);
+    size_t done = fwrite(buffer, 1, bytes, file);
+    pthread_mutex_unlock(&writeAtLock);
+#else
+    size_t done = 0;
+    int fd = fileno(file);
+    while (done < bytes) {
+        ssize_t n = pwrite(fd, (const char *)buffer + done, bytes - done, (off_t)(offset + done));
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+#endif
+    STATS_ADD(bytesWritten, done);
+    return done / sizeof(int);
 }
 
 /**
- * Build loser tree for k-way merging
- * Loser tree is a tournament tree that keeps track of minimum
- * values from multiple sorted runs
- *
- * @param tree Loser tree structure
- * @param runs Array of run files
- * @param k Number of runs
- * @return Index of run with minimum value
+ * Output buffer for runs and merge output
+ * Collects values and writes them with one fwrite per capacity values.
+ * With an AsyncIo the full buffer is handed to the I/O queue and filling
+ * continues in the second buffer; a positioned buffer writes at offset
+ * so several threads can fill one file. A failed or short write sets
+ * error, which stays set and drops everything written after it.
  */
-int BuildLoserTree(LoserTreeNode tree[], RunFile runs[], int k) {
-    // Initialize leaf nodes
-    for (int i = 0; i < k; i++) {
-        tree[k + i].key = runs[i].buffer[runs[i].current];
-        tree[k + i].runIndex = i;
-        tree[k + i].value = runs[i].buffer[runs[i].current];
+typedef struct {
+    FILE *file;
+    int *buffer;
+    int capacity;
+    int count;
+    AsyncIo *io;
+    int *back;              // buffer being written in the background
+    AsyncRequest request;
+    long long offset;       // file offset of the next write
+    int pending;
+    int positioned;
+    int encoded;            // write RunCodec blocks, always blocking
+    char *mapBase;          // mapped output file, buffer is a window into it
+    long long mapValues;    // size of the mapping in values
+    long long mapPosition;  // values before the window
+    long long released;     // bytes already dropped with MADV_DONTNEED
+    int error;
+} OutputBuffer;
+
+static int OpenOutputBuffer(OutputBuffer *out, FILE *file, int capacity, AsyncIo *io) {
+    out->file = file;
+    out->buffer = (int *)malloc(capacity * sizeof(int));
+    out->back = io ? (int *)malloc(capacity * sizeof(int)) : NULL;
+    out->capacity = capacity;
+    out->count = 0;
+    out->io = io;
+    out->offset = 0;
+    out->pending = 0;
+    out->positioned = 0;
+    out->encoded = 0;
+    out->mapBase = NULL;
+    out->error = 0;
+    if (!out->buffer || (io && !out->back)) {
+        free(out->buffer);
+        free(out->back);
+        out->buffer = NULL;
+        return 0;
     }
+    return 1;
+}
 
-    // Initialize losers
-    for (int i = 0; i < k; i++) {
-        int parent = (k + i) / 2;
-        int child = k + i;
+static void WaitOutput(OutputBuffer *out) {
+    if (out->pending) {
+        size_t done = AsyncIoWait(out->io, &out->request);
+        STATS_ADD(bytesWritten, done);
+        if (out->request.error || done != out->request.bytes) {
+            out->error = 1;
+        }
+        out->pending = 0;
+    }
+}
+
+#ifdef EXTERNAL_SORT_MMAP
+// Drop the whole pages of base[*released..end) from this process
+static void ReleasePages(char *base, long long *released, long long end) {
+    long long page = sysconf(_SC_PAGESIZE);
+    long long aligned = end / page * page;
+    if (aligned > *released) {
+        madvise(base + *released, (size_t)(aligned - *released), MADV_DONTNEED);
+        *released = aligned;
+    }
+}
 
-        while (parent >= 1) {
-            int sibling = (parent * 2 == child) ? child + 1 : child - 1;
+// Move the output window past the values written into it
+static void AdvanceMappedOutput(OutputBuffer *out) {
+    out->mapPosition += out->count;
+    STATS_ADD(bytesWritten, out->count * sizeof(int));
+    ReleasePages(out->mapBase, &out->released, out->mapPosition * (long long)sizeof(int));
+    long long left = out->mapValues - out->mapPosition;
+    out->buffer = (int *)out->mapBase + out->mapPosition;
+    out->capacity = left < out->capacity ? (int)left : out->capacity;
+    out->count = 0;
+}
+#endif
 
-            if (tree[child].key < tree[sibling].key) {
-                tree[parent] = tree[sibling];
-                child = parent;
-                parent = child / 2;
-            } else {
-                tree[parent] = tree[child];
-                parent = parent / 2;
-            }
+static void FlushOutput(OutputBuffer *out) {
+    if (out->count == 0) {
+        return;
+    }
+#ifdef EXTERNAL_SORT_MMAP
+    if (out->mapBase) {
+        AdvanceMappedOutput(out);
+        return;
+    }
+#endif
+    if (out->error) {
+        out->count = 0;
+        return;
+    }
+    if (out->encoded) {
+        if (!WriteEncodedInts(out->buffer, out->count, out->file)) {
+            out->error = 1;
+        }
+        out->count = 0;
+        return;
+    }
+    if (out->positioned) {
+        if (WriteIntsAt(out->buffer, out->count, out->file, out->offset) != (size_t)out->count) {
+            out->error = 1;
+        }
+        out->offset += (long long)(out->count * sizeof(int));
+        out->count = 0;
+        return;
+    }
+    if (!out->io) {
+        if (WriteInts(out->buffer, out->count, out->file) != (size_t)out->count) {
+            out->error = 1;
         }
+        out->count = 0;
+        return;
     }
 
-    return tree[1].runIndex;
+    size_t bytes = out->count * sizeof(int);
+    WaitOutput(out);
+    AsyncIoSubmit(out->io, &out->request, out->file, out->buffer, bytes, out->offset, 1);
+    out->offset += (long long)bytes;
+    out->pending = 1;
+
+    int *temp = out->buffer;
+    out->buffer = out->back;
+    out->back = temp;
+    out->count = 0;
+}
+
+// Write everything buffered; call before the file is closed or switched
+static void FinishOutput(OutputBuffer *out) {
+    FlushOutput(out);
+    WaitOutput(out);
+}
+
+static void CloseOutputBuffer(OutputBuffer *out) {
+    FinishOutput(out);
+    free(out->buffer);
+    free(out->back);
+    out->buffer = NULL;
+    out->back = NULL;
+}
+
+static void PutOutput(OutputBuffer *out, int value) {
+    out->buffer[out->count++] = value;
+    if (out->count == out->capacity) {
+        FlushOutput(out);
+    }
 }
 
 /**
- * K-way merge using simple method
- * Repeatedly selects minimum from all active runs
- *
- * @param runs Array of run files
- * @param k Number of runs
- * @param output Output file
+ * Read-ahead state of a run in pipelined mode
+ * While the merge consumes RunFile.buffer the next block is read into back
  */
-void KWayMerge(RunFile runs[], int k, FILE *output) {
-    int activeRuns = k;
+struct AsyncRun {
+    AsyncIo *io;
+    int *back;
+    AsyncRequest request;
+    long long offset;       // file offset of the next read
+    int pending;
+};
 
-    while (activeRuns > 0) {
-        int minValue = 2147483647;
-        int minIndex = -1;
+static void SubmitRunRead(RunFile *run) {
+    struct AsyncRun *async = run->async;
+    AsyncIoSubmit(async->io, &async->request, run->file, async->back,
+                  run->capacity * sizeof(int), async->offset, 0);
+    async->pending = 1;
+}
 
-        // Find minimum among all active runs
-        for (int i = 0; i < k; i++) {
-            if (runs[i].valid && runs[i].current < MEMORY_BUFFER) {
-                if (runs[i].buffer[runs[i].current] < minValue) {
-                    minValue = runs[i].buffer[runs[i].current];
-                    minIndex = i;
-                }
-            }
-        }
+// Start reading a run at offset in the background; the run stays blocking if this fails
+static void StartPrefetch(RunFile *run, AsyncIo *io, long long offset) {
+    struct AsyncRun *async = (struct AsyncRun *)malloc(sizeof(struct AsyncRun));
+    if (!async) {
+        return;
+    }
+    async->back = (int *)malloc(run->capacity * sizeof(int));
+    if (!async->back) {
+        free(async);
+        return;
+    }
+    async->io = io;
+    async->offset = offset;
+    async->pending = 0;
+    run->async = async;
+    SubmitRunRead(run);
+}
+
+static void StopPrefetch(RunFile *run) {
+    struct AsyncRun *async = run->async;
+    if (!async) {
+        return;
+    }
+    if (async->pending) {
+        AsyncIoWait(async->io, &async->request);
+    }
+    free(async->back);
+    free(async);
+    run->async = NULL;
+}
 
-        if (minIndex != -1) {
-            fwrite(&minValue, sizeof(int), 1, output);
+/**
+ * Open a run file for merging
+ * Allocates a read buffer of capacity values
+ *
+ * @param run Run to initialize
+ * @param filename Path to run file
+ * @param capacity Buffer size in values
+ * @return 1 on success, 0 on failure
+ */
+int OpenRunFile(RunFile *run, const char *filename, int capacity) {
+    run->file = fopen(filename, "rb");
+    if (!run->file) {
+        return 0;
+    }
+    run->buffer = (int *)malloc(capacity * sizeof(int));
+    if (!run->buffer) {
+        fclose(run->file);
+        return 0;
+    }
+    run->capacity = capacity;
+    run->current = 0;
+    run->valid = 0;
+    run->remaining = -1;
+    run->async = NULL;
+    run->mapped = NULL;
+    run->encoded = 0;
+    run->error = 0;
+    return 1;
+}
 
-            runs[minIndex].current++;
-            // Read next chunk if buffer exhausted
-            if (runs[minIndex].current >= MEMORY_BUFFER ||
-                runs[minIndex].current >= runs[minIndex].valid) {
-                runs[minIndex].valid = fread(runs[minIndex].buffer,
-                                          sizeof(int),
-                                          MEMORY_BUFFER,
-                                          runs[minIndex].file);
-                runs[minIndex].current = 0;
+/**
+ * Mapping of a run merged in mmap mode
+ * RunFile.buffer is a window of the mapping instead of an allocation
+ */
+struct MappedRun {
+    char *base;
+    long long values;
+    long long position;     // values before the window
+    long long released;     // bytes already dropped with MADV_DONTNEED
+};
 
-                if (runs[minIndex].valid <= 0) {
-                    runs[minIndex].valid = 0;
-                    activeRuns--;
-                }
-            }
+void CloseRunFile(RunFile *run) {
+    if (!run->file) {
+        return;
+    }
+#ifdef EXTERNAL_SORT_MMAP
+    if (run->mapped) {
+        if (run->mapped->base) {
+            munmap(run->mapped->base, (size_t)(run->mapped->values * sizeof(int)));
         }
+        free(run->mapped);
+        run->mapped = NULL;
+        run->buffer = NULL;
     }
+#endif
+    StopPrefetch(run);
+    fclose(run->file);
+    free(run->buffer);
+    run->file = NULL;
+    run->buffer = NULL;
 }
 
 /**
- * K-way merge using loser tree
- * More efficient than simple K-way merge for large k
+ * Make sure a run has a value at its current position
+ * Reads the next block of the run file when the buffer is drained
  *
- * @param runs Array of run files
- * @param k Number of runs
- * @param output Output file
+ * @param run Run to refill
+ * @return 1 if the run has data, 0 once it is exhausted
  */
-void LoserTreeMerge(RunFile runs[], int k, FILE *output) {
-    LoserTreeNode tree[2 * k];
-
-    // Initialize all buffers
-    for (int i = 0; i < k; i++) {
-        runs[i].valid = fread(runs[i].buffer, sizeof(int), MEMORY_BUFFER, runs[i].file);
-        runs[i].current = 0;
+static int RefillRun(RunFile *run) {
+    if (run->current < run->valid) {
+        return 1;
     }
-
-    while (1) {
-        // Check if any data remains
-        int hasData = 0;
-        for (int i = 0; i < k; i++) {
-            if (runs[i].valid && runs[i].current < runs[i].valid) {
-                hasData = 1;
-                break;
-            }
+#ifdef EXTERNAL_SORT_MMAP
+    if (run->mapped) {
+        // Slide the window over the mapping, dropping the pages behind it
+        struct MappedRun *mapped = run->mapped;
+        mapped->position += run->valid;
+        ReleasePages(mapped->base, &mapped->released, mapped->position * (long long)sizeof(int));
+        long long left = mapped->values - mapped->position;
+        run->buffer = (int *)mapped->base + mapped->position;
+        run->valid = left < run->capacity ? (int)left : run->capacity;
+        run->current = 0;
+        STATS_ADD(bytesRead, run->valid * sizeof(int));
+        return run->valid > 0;
+    }
+#endif
+    if (run->encoded) {
+        run->valid = ReadEncodedInts(run->buffer, run->capacity, run->file, &run->error);
+        run->current = 0;
+        return run->valid > 0;
+    }
+    if (run->async) {
+        // Swap in the block read in the background and start the next one
+        struct AsyncRun *async = run->async;
+        run->current = 0;
+        run->valid = 0;
+        if (!async->pending) {
+            return 0;
         }
+        size_t bytes = AsyncIoWait(async->io, &async->request);
+        async->pending = 0;
+        STATS_ADD(bytesRead, bytes);
 
-        if (!hasData) {
-            break;
+        int *temp = run->buffer;
+        run->buffer = async->back;
+        async->back = temp;
+        run->valid = (int)(bytes / sizeof(int));
+        async->offset += (long long)bytes;
+        if (bytes == run->capacity * sizeof(int)) {
+            SubmitRunRead(run);
         }
+        return run->valid > 0;
+    }
+    int want = run->capacity;
+    if (run->remaining >= 0 && run->remaining < want) {
+        want = (int)run->remaining;
+    }
+    run->valid = want > 0 ? (int)ReadInts(run->buffer, want, run->file) : 0;
+    run->current = 0;
+    if (run->remaining >= 0) {
+        run->remaining -= run->valid;
+    }
+    return run->valid > 0;
+}
 
-        // Get minimum value using loser tree
-        int minIndex = BuildLoserTree(tree, runs, k);
+#define RUN_PATH_MAX 1024
 
-        if (minIndex == -1) {
-            break;
-        }
+/**
+ * Where a sort puts its run files and how large its I/O blocks are
+ * Runs are numbered from 0 in the order they are created; io is set in
+ * pipelined mode, threads above 1 in parallel mode, compress when run
+ * files hold RunCodec blocks, records when runs hold records instead of
+ * ints. With a manifest, every finished run and merge is logged;
+ * inputOffset is where the next run starts in the input.
+ */
+typedef struct {
+    const char *tempDir;
+    int ioBlock;
+    int nextRun;
+    AsyncIo *io;
+    int threads;
+    int mapped;
+    int compress;
+    const RecordLayout *records;
+    FILE *manifest;
+    long long inputOffset;
+    int dropConsumed;
+} SortJob;
+
+static void InitSortJob(SortJob *job, const char *tempDir, int ioBlock) {
+    job->tempDir = tempDir ? tempDir : ".";
+    job->ioBlock = ioBlock;
+    job->nextRun = 0;
+    job->io = NULL;
+    job->threads = 1;
+    job->mapped = 0;
+    job->compress = 0;
+    job->records = NULL;
+    job->manifest = NULL;
+    job->inputOffset = 0;
+    job->dropConsumed = 0;
+}
 
-        // Output minimum value
-        fwrite(&runs[minIndex].buffer[runs[minIndex].current], sizeof(int), 1, output);
+static void RunPath(const SortJob *job, int id, char *path) {
+    snprintf(path, RUN_PATH_MAX, "%s/run_%d.tmp", job->tempDir, id);
+}
 
-        // Read next value from corresponding run
-        runs[minIndex].current++;
+static FILE *CreateRunFile(SortJob *job, int *id) {
+    char filename[RUN_PATH_MAX];
+    *id = job->nextRun++;
+    RunPath(job, *id, filename);
+    FILE *file = fopen(filename, "w+b");
+    if (!file) {
+        printf("Cannot create run file: %s\n", filename);
+    }
+    return file;
+}
 
-        if (runs[minIndex].current >= runs[minIndex].valid) {
-            runs[minIndex].valid = fread(runs[minIndex].buffer,
-                                      sizeof(int),
-                                      MEMORY_BUFFER,
-                                      runs[minIndex].file);
-            runs[minIndex].current = 0;
-        }
+// Write a whole run, encoded when the job compresses runs
+static int WriteRun(const SortJob *job, const int *values, int count, FILE *file) {
+    if (job->compress) {
+        return WriteEncodedInts(values, count, file);
+    }
+    return WriteInts(values, count, file) == (size_t)count;
+}
+
+static void RemoveRuns(const SortJob *job, const int *ids, int count) {
+    char filename[RUN_PATH_MAX];
+    for (int i = 0; i < count; i++) {
+        RunPath(job, ids ? ids[i] : i, filename);
+        remove(filename);
+    }
+}
+
+// Append a line to the job manifest, if any, and hand it to the OS
+static void LogProgress(SortJob *job, const char *format, ...) {
+    if (!job->manifest) {
+        return;
     }
+    va_list args;
+    va_start(args, format);
+    vfprintf(job->manifest, format, args);
+    va_end(args);
+    fflush(job->manifest);
 }
 
 /**
- * Phase 2: Merge all sorted runs
- * Opens all run files and merges them into single output file
- *
- * @param outputFile Path to output file
- * @param runCount Number of runs to merge
+ * Pipelined chunk runs: the next chunk is read into the second half of
+ * the buffer while the current one is sorted and written
  */
-void MergeRuns(const char *outputFile, int runCount) {
-    FILE *output = fopen(outputFile, "w");
-    if (!output) {
-        printf("Cannot create output file: %s\n", outputFile);
-        return;
+static int GenerateChunkRunsAsync(SortJob *job, FILE *input, int *chunk, int chunkSize,
+                                  void (*sort)(int *, int, int)) {
+    int *current = chunk, *next = chunk + chunkSize;
+    size_t chunkBytes = chunkSize * sizeof(int);
+    AsyncRequest read, write;
+    long long offset = job->inputOffset;
+    int runCount = 0;
+
+    AsyncIoSubmit(job->io, &read, input, current, chunkBytes, offset, 0);
+    size_t bytes = AsyncIoWait(job->io, &read);
+    while (bytes >= sizeof(int)) {
+        int count = (int)(bytes / sizeof(int));
+        int more = bytes == chunkBytes;
+        STATS_ADD(bytesRead, bytes);
+        offset += (long long)bytes;
+        if (more) {
+            AsyncIoSubmit(job->io, &read, input, next, chunkBytes, offset, 0);
+        }
+
+        sort(current, 0, count - 1);
+
+        int id;
+        FILE *runFile = CreateRunFile(job, &id);
+        if (!runFile) {
+            if (more) AsyncIoWait(job->io, &read);
+            return -1;
+        }
+        int written;
+        if (job->compress) {
+            written = WriteRun(job, current, count, runFile);
+        } else {
+            AsyncIoSubmit(job->io, &write, runFile, current, count * sizeof(int), 0, 1);
+            size_t done = AsyncIoWait(job->io, &write);
+            STATS_ADD(bytesWritten, done);
+            written = !write.error && done == count * sizeof(int);
+        }
+        if (fclose(runFile) != 0 || !written) {
+            printf("Cannot write run file %d\n", id);
+            if (more) AsyncIoWait(job->io, &read);
+            return -1;
+        }
+        runCount++;
+        job->inputOffset += (long long)count * sizeof(int);
+        LogProgress(job, "run %d %lld\n", id, job->inputOffset);
+
+        bytes = more ? AsyncIoWait(job->io, &read) : 0;
+        int *temp = current;
+        current = next;
+        next = temp;
     }
+    return runCount;
+}
 
-    RunFile runs[MAX_RUNS];
+/**
+ * Parallel chunk runs
+ * Every thread owns one chunk. Reading the input and numbering the run
+ * happen under a lock; sorting and writing the run do not, so one thread
+ * reads while the others sort.
+ */
+typedef struct {
+    SortJob *job;
+    FILE *input;
+    int chunkSize;
+    pthread_mutex_t lock;
+    int runCount;
+    int failed;
+} ChunkWork;
 
-    // Open all run files
-    for (int i = 0; i < runCount; i++) {
-        char filename[100];
-        sprintf(filename, "run_%d.tmp", i);
+typedef struct {
+    ChunkWork *work;
+    int *chunk;
+} ChunkWorker;
 
-        runs[i].file = fopen(filename, "r");
-        if (!runs[i].file) {
-            printf("Cannot open run file: %s\n", filename);
-            for (int j = 0; j < i; j++) {
-                fclose(runs[j].file);
+static void *ChunkRunWorker(void *arg) {
+    ChunkWorker *worker = (ChunkWorker *)arg;
+    ChunkWork *work = worker->work;
+
+    for (;;) {
+        FILE *runFile = NULL;
+        int id;
+        pthread_mutex_lock(&work->lock);
+        int count = work->failed ? 0 : (int)ReadInts(worker->chunk, work->chunkSize, work->input);
+        if (count > 0) {
+            runFile = CreateRunFile(work->job, &id);
+            if (runFile) {
+                work->runCount++;
+            } else {
+                work->failed = 1;
             }
-            fclose(output);
-            return;
+        }
+        pthread_mutex_unlock(&work->lock);
+        if (!runFile) {
+            break;
         }
 
-        runs[i].current = 0;
-        runs[i].valid = 0;
+        QuickSort(worker->chunk, 0, count - 1);
+        int written = WriteRun(work->job, worker->chunk, count, runFile);
+        if (fclose(runFile) != 0 || !written) {
+            pthread_mutex_lock(&work->lock);
+            work->failed = 1;
+            pthread_mutex_unlock(&work->lock);
+            break;
+        }
     }
+    return NULL;
+}
 
-    // Use K-way merge
-    KWayMerge(runs, runCount, output);
+static int GenerateChunkRunsParallel(SortJob *job, FILE *input, int *chunk, int chunkSize) {
+    int threads = job->threads;
+    pthread_t *ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    ChunkWorker *workers = (ChunkWorker *)malloc(threads * sizeof(ChunkWorker));
+    if (!ids || !workers) {
+        free(ids);
+        free(workers);
+        return -1;
+    }
 
-    // Close all files and cleanup
-    for (int i = 0; i < runCount; i++) {
-        fclose(runs[i].file);
+    ChunkWork work;
+    work.job = job;
+    work.input = input;
+    work.chunkSize = chunkSize;
+    work.runCount = 0;
+    work.failed = 0;
+    pthread_mutex_init(&work.lock, NULL);
 
-        char filename[100];
-        sprintf(filename, "run_%d.tmp", i);
-        remove(filename);
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        workers[t].work = &work;
+        workers[t].chunk = chunk + (size_t)t * chunkSize;
+        if (pthread_create(&ids[t], NULL, ChunkRunWorker, &workers[t]) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        ChunkRunWorker(&workers[0]);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
     }
 
-    fclose(output);
-    printf("Merged %d runs into %s\n", runCount, outputFile);
+    pthread_mutex_destroy(&work.lock);
+    free(ids);
+    free(workers);
+    return work.failed ? -1 : work.runCount;
 }
 
 /**
- * External sort main function
- * Orchestrates the two-phase external sorting process
- *
- * Phase 1: Create initial sorted runs from input file
- * Phase 2: Merge all runs into final sorted output
+ * Sort the input chunk by chunk and write every chunk as one run
+ * Starts at job->inputOffset and logs every run with the input offset
+ * it ends at, so a resumed job can continue after the last logged run
  *
- * @param inputFile Path to input file
- * @param outputFile Path to output file
+ * @param job Run naming
+ * @param input Input file
+ * @param chunk Buffer of chunkSize values (2 * chunkSize with job->io)
+ * @param chunkSize Values per run
+ * @param sort In-memory sort, called as sort(chunk, 0, count - 1)
+ * @return Number of runs created, or -1 on error
  */
-void ExternalSort(const char *inputFile, const char *outputFile) {
-    printf("External Sort: %s -> %s\n", inputFile, outputFile);
-
-    // Phase 1: Create initial runs
-    printf("Phase 1: Creating initial runs...\n");
-    int runCount = CreateRuns(inputFile);
-
-    if (runCount <= 0) {
-        printf("No data to sort or error occurred.\n");
-        return;
+static int GenerateChunkRuns(SortJob *job, FILE *input, int *chunk, int chunkSize,
+                             void (*sort)(int *, int, int)) {
+    if (job->io) {
+        return GenerateChunkRunsAsync(job, input, chunk, chunkSize, sort);
     }
 
-    printf("Created %d initial runs\n", runCount);
+    int runCount = 0;
+    int count;
 
-    // Phase 2: Merge all runs
-    printf("Phase 2: Merging runs...\n");
-    MergeRuns(outputFile, runCount);
+    while ((count = (int)ReadInts(chunk, chunkSize, input)) > 0) {
+        sort(chunk, 0, count - 1);
 
-    printf("External sort completed!\n");
+        int id;
+        FILE *runFile = CreateRunFile(job, &id);
+        if (!runFile) {
+            return -1;
+        }
+        int written = WriteRun(job, chunk, count, runFile);
+        if (fclose(runFile) != 0 || !written) {
+            printf("Cannot write run file %d\n", id);
+            return -1;
+        }
+        runCount++;
+        job->inputOffset += (long long)count * sizeof(int);
+        LogProgress(job, "run %d %lld\n", id, job->inputOffset);
+    }
+    return runCount;
+}
+
+/**
+ * Phase 1: Create initial sorted runs
+ * Reads data from input file, sorts chunks in memory,
+ * and writes them to temporary run files
+ *
+ * @param inputFile Path to input file
+ * @return Number of runs created, or -1 on error
+ */
+int CreateRuns(const char *inputFile) {
+    FILE *input = fopen(inputFile, "rb");
+    if (!input) {
+        printf("Cannot open input file: %s\n", inputFile);
+        return -1;
+    }
+
+    SortJob job;
+    int buffer[MEMORY_BUFFER];
+    InitSortJob(&job, NULL, MEMORY_BUFFER);
+
+    // Read file in chunks, sort each chunk, write to run file
+    int runCount = GenerateChunkRuns(&job, input, buffer, MEMORY_BUFFER, QuickSortExternal);
+
+    fclose(input);
+    return runCount;
+}
+
+static void SiftDownRunHeap(int *heap, int k, int n) {
+    int temp = heap[k];
+    for (int i = 2 * k + 1; i < n; i = 2 * i + 1) {
+        if (i + 1 < n && heap[i + 1] < heap[i]) i++;
+        if (temp <= heap[i]) break;
+        heap[k] = heap[i];
+        k = i;
+    }
+    heap[k] = temp;
+}
+
+static void BuildRunHeap(int *heap, int n) {
+    for (int i = n / 2 - 1; i >= 0; i--) {
+        SiftDownRunHeap(heap, i, n);
+    }
+}
+
+/**
+ * Replacement selection
+ * A min-heap repeatedly outputs its smallest value and takes the next
+ * input in its place. An input smaller than the value just written cannot
+ * join the current run: it is parked behind the heap, which shrinks by
+ * one, and becomes part of the next run once the heap is empty. Random
+ * input gives runs of about twice the heap size; sorted input gives a
+ * single run.
+ *
+ * @param job Run naming and I/O block size
+ * @param inputFile Input file
+ * @param heapSize Heap capacity in values
+ * @return Number of runs created, or -1 on error
+ */
+static int GenerateHeapRuns(SortJob *job, FILE *inputFile, int heapSize) {
+    RunFile input;
+    OutputBuffer out;
+    int *heap = (int *)malloc(heapSize * sizeof(int));
+    input.file = inputFile;
+    input.buffer = (int *)malloc(job->ioBlock * sizeof(int));
+    input.capacity = job->ioBlock;
+    input.current = 0;
+    input.valid = 0;
+    input.remaining = -1;
+    input.async = NULL;
+    input.mapped = NULL;
+    input.encoded = 0;
+    input.error = 0;
+    if (!heap || !input.buffer || !OpenOutputBuffer(&out, NULL, job->ioBlock, job->compress ? NULL : job->io)) {
+        free(heap);
+        free(input.buffer);
+        return -1;
+    }
+    if (job->io) {
+        StartPrefetch(&input, job->io, job->inputOffset);
+    }
+    out.encoded = job->compress;
+
+    // heap[0..active) is the current run's heap, heap[active..n) the next run
+    int n = 0;
+    while (n < heapSize && RefillRun(&input)) {
+        heap[n++] = input.buffer[input.current++];
+    }
+    int active = n;
+    BuildRunHeap(heap, active);
+
+    int runCount = 0;
+    int ok = 1;
+    while (n > 0) {
+        if (!out.file) {
+            int id;
+            out.file = CreateRunFile(job, &id);
+            out.offset = 0;
+            if (!out.file) {
+                ok = 0;
+                break;
+            }
+            runCount++;
+        }
+
+        int key = heap[0];
+        PutOutput(&out, key);
+
+        if (RefillRun(&input)) {
+            int next = input.buffer[input.current++];
+            if (next >= key) {
+                heap[0] = next;
+            } else {
+                heap[0] = heap[active - 1];
+                heap[active - 1] = next;
+                active--;
+            }
+        } else {
+            // Input exhausted: drop the root and close the gap it leaves
+            heap[0] = heap[active - 1];
+            heap[active - 1] = heap[n - 1];
+            active--;
+            n--;
+        }
+        SiftDownRunHeap(heap, 0, active);
+
+        // Current run finished: the parked values form the next heap
+        if (active == 0) {
+            FinishOutput(&out);
+            if (fclose(out.file) != 0 || out.error) {
+                out.file = NULL;
+                ok = 0;
+                break;
+            }
+            out.file = NULL;
+            active = n;
+            BuildRunHeap(heap, active);
+        }
+    }
+
+    if (out.file) {
+        FinishOutput(&out);
+        if (fclose(out.file) != 0 || out.error) {
+            ok = 0;
+        }
+    }
+    CloseOutputBuffer(&out);
+    StopPrefetch(&input);
+    free(input.buffer);
+    free(heap);
+    return ok ? runCount : -1;
+}
+
+/**
+ * Phase 1 (alternative): Create runs by replacement selection
+ * Uses a heap of MEMORY_BUFFER values
+ *
+ * @param inputFile Path to input file
+ * @return Number of runs created, or -1 on error
+ */
+int CreateRunsReplacementSelection(const char *inputFile) {
+    FILE *input = fopen(inputFile, "rb");
+    if (!input) {
+        printf("Cannot open input file: %s\n", inputFile);
+        return -1;
+    }
+
+    SortJob job;
+    InitSortJob(&job, NULL, MEMORY_BUFFER);
+    int runCount = GenerateHeapRuns(&job, input, MEMORY_BUFFER);
+
+    fclose(input);
+    return runCount;
+}
+
+/**
+ * Leaf of the loser tree for run i
+ * An exhausted run becomes a +infinity sentinel
+ */
+static LoserTreeNode LeafNode(RunFile runs[], int i) {
+    LoserTreeNode node;
+    node.runIndex = i;
+    node.exhausted = !RefillRun(&runs[i]);
+    node.key = node.exhausted ? 0 : runs[i].buffer[runs[i].current];
+    node.value = node.key;
+    return node;
+}
+
+/**
+ * Tournament order: runIndex -1 is -infinity (used while building),
+ * exhausted runs are +infinity, ties go to the lower run index
+ */
+static int NodeBeats(const LoserTreeNode *a, const LoserTreeNode *b) {
+    if (a->runIndex < 0) return 1;
+    if (b->runIndex < 0) return 0;
+    if (a->exhausted) return 0;
+    if (b->exhausted) return 1;
+    return a->key < b->key || (a->key == b->key && a->runIndex < b->runIndex);
+}
+
+/**
+ * Replay the path from a leaf to the root
+ * Each internal node on the path keeps the loser, the winner moves up;
+ * the overall winner ends up in tree[0]. Costs O(log k) comparisons.
+ *
+ * @param tree Loser tree (k nodes)
+ * @param k Number of runs
+ * @param node New leaf value
+ */
+static void ReplayLoserTree(LoserTreeNode tree[], int k, LoserTreeNode node) {
+    for (int t = (node.runIndex + k) / 2; t > 0; t /= 2) {
+        if (NodeBeats(&tree[t], &node)) {
+            LoserTreeNode temp = tree[t];
+            tree[t] = node;
+            node = temp;
+        }
+    }
+    tree[0] = node;
+}
+
+/**
+ * Build loser tree for k-way merging
+ * Internal nodes tree[1..k-1] hold the losers of each match and tree[0]
+ * holds the overall winner; leaf i sits at position k + i. Internal nodes
+ * start as -infinity and every leaf is replayed once.
+ *
+ * @param tree Loser tree structure (k nodes)
+ * @param runs Array of run files
+ * @param k Number of runs
+ * @return Index of run with minimum value, or -1 if all runs are empty
+ */
+int BuildLoserTree(LoserTreeNode tree[], RunFile runs[], int k) {
+    for (int t = 0; t < k; t++) {
+        tree[t].runIndex = -1;
+        tree[t].exhausted = 0;
+    }
+    for (int i = k - 1; i >= 0; i--) {
+        ReplayLoserTree(tree, k, LeafNode(runs, i));
+    }
+    return tree[0].exhausted ? -1 : tree[0].runIndex;
+}
+
+/**
+ * K-way merge using simple method
+ * Repeatedly selects minimum from all active runs
+ *
+ * @param runs Array of run files
+ * @param k Number of runs
+ * @param output Output file
+ */
+void KWayMerge(RunFile runs[], int k, FILE *output) {
+    OutputBuffer out;
+    if (!OpenOutputBuffer(&out, output, MEMORY_BUFFER, NULL)) {
+        return;
+    }
+
+    while (1) {
+        int minIndex = -1;
+
+        // Find minimum among all active runs
+        for (int i = 0; i < k; i++) {
+            if (RefillRun(&runs[i])) {
+                if (minIndex == -1 ||
+                    runs[i].buffer[runs[i].current] < runs[minIndex].buffer[runs[minIndex].current]) {
+                    minIndex = i;
+                }
+            }
+        }
+
+        if (minIndex == -1) {
+            break;
+        }
+
+        PutOutput(&out, runs[minIndex].buffer[runs[minIndex].current]);
+        runs[minIndex].current++;
+    }
+
+    CloseOutputBuffer(&out);
+}
+
+/**
+ * Loser tree merge of k runs into an output buffer
+ * With dropJob, run r (file ids[r]) is closed and deleted as soon as it
+ * is exhausted instead of when the whole merge is done
+ */
+static int MergeToBuffer(RunFile runs[], int k, OutputBuffer *out, const SortJob *dropJob, const int *ids) {
+    LoserTreeNode *tree = (LoserTreeNode *)malloc(k * sizeof(LoserTreeNode));
+    if (!tree) {
+        return 0;
+    }
+
+    BuildLoserTree(tree, runs, k);
+    while (!tree[0].exhausted) {
+        int r = tree[0].runIndex;
+        PutOutput(out, tree[0].key);
+        runs[r].current++;
+        LoserTreeNode node = LeafNode(runs, r);
+        if (node.exhausted && dropJob) {
+            char filename[RUN_PATH_MAX];
+            CloseRunFile(&runs[r]);
+            RunPath(dropJob, ids[r], filename);
+            remove(filename);
+        }
+        ReplayLoserTree(tree, k, node);
+    }
+
+    FinishOutput(out);
+    free(tree);
+    // A run cut short by a bad block leaves its tail out of the merge
+    int ok = !out->error;
+    for (int i = 0; i < k; i++) {
+        if (runs[i].error) {
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+/**
+ * K-way merge using loser tree
+ * After each output only the path from the winning leaf is replayed,
+ * so every record costs O(log k) comparisons
+ *
+ * @param runs Array of run files
+ * @param k Number of runs
+ * @param output Output file
+ */
+void LoserTreeMerge(RunFile runs[], int k, FILE *output) {
+    OutputBuffer out;
+    if (!OpenOutputBuffer(&out, output, MEMORY_BUFFER, NULL)) {
+        return;
+    }
+    MergeToBuffer(runs, k, &out, NULL, NULL);
+    CloseOutputBuffer(&out);
+}
+
+/**
+ * Phase 2: Merge all sorted runs
+ * Opens all run files and merges them into single output file
+ *
+ * @param outputFile Path to output file
+ * @param runCount Number of runs to merge
+ */
+void MergeRuns(const char *outputFile, int runCount) {
+    FILE *output = fopen(outputFile, "wb");
+    if (!output) {
+        printf("Cannot create output file: %s\n", outputFile);
+        return;
+    }
+
+    RunFile runs[MAX_RUNS];
+    SortJob job;
+    InitSortJob(&job, NULL, MEMORY_BUFFER);
+
+    // Open all run files
+    for (int i = 0; i < runCount; i++) {
+        char filename[RUN_PATH_MAX];
+        RunPath(&job, i, filename);
+
+        if (!OpenRunFile(&runs[i], filename, MEMORY_BUFFER)) {
+            printf("Cannot open run file: %s\n", filename);
+            for (int j = 0; j < i; j++) {
+                CloseRunFile(&runs[j]);
+            }
+            fclose(output);
+            return;
+        }
+    }
+
+    // Use loser tree K-way merge
+    LoserTreeMerge(runs, runCount, output);
+    externalSortStats.merges++;
+
+    // Close all files and cleanup
+    for (int i = 0; i < runCount; i++) {
+        CloseRunFile(&runs[i]);
+    }
+    RemoveRuns(&job, NULL, runCount);
+
+    fclose(output);
+    printf("Merged %d runs into %s\n", runCount, outputFile);
+}
+
+/**
+ * External sort main function
+ * Orchestrates the two-phase external sorting process
+ *
+ * Phase 1: Create initial sorted runs from input file
+ * Phase 2: Merge all runs into final sorted output
+ *
+ * @param inputFile Path to input file
+ * @param outputFile Path to output file
+ */
+void ExternalSort(const char *inputFile, const char *outputFile) {
+    printf("External Sort: %s -> %s\n", inputFile, outputFile);
+
+    // Phase 1: Create initial runs
+    printf("Phase 1: Creating initial runs...\n");
+    double start = PhaseClock();
+    int runCount;
+    if (runGeneration == RUNS_REPLACEMENT_SELECTION) {
+        runCount = CreateRunsReplacementSelection(inputFile);
+    } else {
+        runCount = CreateRuns(inputFile);
+    }
+
+    if (runCount <= 0) {
+        printf("No data to sort or error occurred.\n");
+        return;
+    }
+
+    printf("Created %d initial runs\n", runCount);
+    externalSortStats.runs = runCount;
+    if (runCount > MAX_RUNS) {
+        printf("Too many runs to merge (maximum %d), use ExternalSortEx\n", MAX_RUNS);
+        SortJob job;
+        InitSortJob(&job, NULL, MEMORY_BUFFER);
+        RemoveRuns(&job, NULL, runCount);
+        return;
+    }
+
+    // Phase 2: Merge all runs
+    printf("Phase 2: Merging runs...\n");
+    start = EndRunPhase(start);
+    MergeRuns(outputFile, runCount);
+    externalSortStats.mergePasses = 1;
+    externalSortStats.mergeSeconds = PhaseClock() - start;
+
+    printf("External sort completed!\n");
+}
+
+void ExternalSortDefaultConfig(ExternalSortConfig *cfg) {
+    cfg->memoryBytes = EXTERNAL_SORT_DEFAULT_MEMORY;
+    cfg->tempDir = NULL;
+    cfg->maxFanIn = 0;
+    cfg->runGeneration = RUNS_QUICKSORT;
+    cfg->io = EXTERNAL_IO_BLOCKING;
+    cfg->threads = 1;
+    cfg->compressRuns = 0;
+    cfg->jobDir = NULL;
+    cfg->dropConsumedRuns = 0;
+}
+
+/**
+ * Merge runs ids[0..k) into an open output file
+ * Compressed runs are read and written with blocking I/O
+ *
+ * @param job Run naming
+ * @param ids Run numbers to merge
+ * @param k Number of runs
+ * @param output Output file
+ * @param block Buffer size per run and for the output, in values
+ * @param toRun Output is a run file, encoded when the job compresses runs
+ * @return 1 on success, 0 on failure
+ */
+static int MergeRunGroupSerial(SortJob *job, const int *ids, int k, FILE *output, int block, int toRun) {
+    RunFile *runs = (RunFile *)malloc(k * sizeof(RunFile));
+    OutputBuffer out;
+    int opened = 0;
+    int encodeOutput = toRun && job->compress;
+    int ok = runs != NULL && OpenOutputBuffer(&out, output, block, encodeOutput ? NULL : job->io);
+    if (ok) {
+        out.encoded = encodeOutput;
+    }
+
+    while (ok && opened < k) {
+        char filename[RUN_PATH_MAX];
+        RunPath(job, ids[opened], filename);
+        if (!OpenRunFile(&runs[opened], filename, block)) {
+            printf("Cannot open run file: %s\n", filename);
+            ok = 0;
+            break;
+        }
+        runs[opened].encoded = job->compress;
+        if (job->io && !job->compress) {
+            StartPrefetch(&runs[opened], job->io, 0);
+        }
+        opened++;
+    }
+
+    if (ok) {
+        ok = MergeToBuffer(runs, k, &out, job->dropConsumed ? job : NULL, ids);
+        externalSortStats.merges++;
+    }
+    for (int i = 0; i < opened; i++) {
+        CloseRunFile(&runs[i]);
+    }
+    if (runs && out.buffer) {
+        CloseOutputBuffer(&out);
+    }
+    free(runs);
+    return ok;
+}
+
+#define SPLITTER_OVERSAMPLE 64
+
+// Read the value at index of a run file
+static int ReadIntAt(FILE *file, long long index, int *value) {
+    return SeekFile(file, index * (long long)sizeof(int), SEEK_SET) == 0 &&
+           fread(value, sizeof(int), 1, file) == 1;
+}
+
+// First index of a sorted run file whose value is not less than key
+static long long RunLowerBound(FILE *file, long long length, int key) {
+    long long low = 0, high = length;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        int value;
+        if (!ReadIntAt(file, mid, &value)) {
+            return mid;
+        }
+        if (value < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * One key range of a parallel merge
+ * bounds[r] and bounds[k + r] delimit the range in run r; the slice is
+ * written at the sum of the lower bounds
+ */
+typedef struct {
+    SortJob *job;
+    const int *ids;
+    int k;
+    FILE *output;
+    int block;
+    const long long *bounds;
+    int ok;
+} MergeSlice;
+
+static void *MergeSliceWorker(void *arg) {
+    MergeSlice *slice = (MergeSlice *)arg;
+    int k = slice->k;
+    RunFile *runs = (RunFile *)malloc(k * sizeof(RunFile));
+    OutputBuffer out;
+    int opened = 0;
+    long long offset = 0;
+
+    slice->ok = runs != NULL && OpenOutputBuffer(&out, slice->output, slice->block, NULL);
+    while (slice->ok && opened < k) {
+        char filename[RUN_PATH_MAX];
+        long long start = slice->bounds[opened];
+        RunPath(slice->job, slice->ids[opened], filename);
+        if (!OpenRunFile(&runs[opened], filename, slice->block)) {
+            slice->ok = 0;
+            break;
+        }
+        opened++;
+        if (SeekFile(runs[opened - 1].file, start * (long long)sizeof(int), SEEK_SET) != 0) {
+            slice->ok = 0;
+            break;
+        }
+        runs[opened - 1].remaining = slice->bounds[k + opened - 1] - start;
+        offset += start * (long long)sizeof(int);
+    }
+
+    if (slice->ok) {
+        out.positioned = 1;
+        out.offset = offset;
+        slice->ok = MergeToBuffer(runs, k, &out, NULL, NULL);
+    }
+    for (int i = 0; i < opened; i++) {
+        CloseRunFile(&runs[i]);
+    }
+    if (runs && out.buffer) {
+        CloseOutputBuffer(&out);
+    }
+    free(runs);
+    return NULL;
+}
+
+/**
+ * Parallel merge of runs ids[0..k) into output
+ * Keys sampled evenly from every run give threads - 1 splitters. A binary
+ * search in each run file turns every splitter into a position, so thread
+ * t merges the keys between splitters t - 1 and t from all runs and
+ * writes them where they belong in the output. Equal keys always fall in
+ * the same range, so heavy duplicates can unbalance the threads.
+ */
+static int MergeRunGroupParallel(SortJob *job, const int *ids, int k, FILE *output, int block) {
+    int threads = job->threads;
+    long long *length = (long long *)malloc(k * sizeof(long long));
+    long long *bounds = (long long *)malloc((size_t)(threads + 1) * k * sizeof(long long));
+    FILE **probe = (FILE **)calloc(k, sizeof(FILE *));
+    int sampleCount = SPLITTER_OVERSAMPLE * threads + k;
+    int *samples = (int *)malloc(sampleCount * sizeof(int));
+    int ok = length && bounds && probe && samples;
+
+    // Run lengths and evenly spaced samples
+    long long total = 0;
+    for (int r = 0; ok && r < k; r++) {
+        char filename[RUN_PATH_MAX];
+        RunPath(job, ids[r], filename);
+        probe[r] = fopen(filename, "rb");
+        ok = probe[r] && SeekFile(probe[r], 0, SEEK_END) == 0;
+        if (ok) {
+            length[r] = TellFile(probe[r]) / (long long)sizeof(int);
+            total += length[r];
+        }
+    }
+
+    if (ok && total >= (long long)threads * EXTERNAL_SORT_MIN_BLOCK) {
+        int count = 0;
+        for (int r = 0; r < k; r++) {
+            long long m = length[r] * (SPLITTER_OVERSAMPLE * threads) / total + 1;
+            if (m > length[r]) m = length[r];
+            for (long long i = 0; i < m && count < sampleCount; i++) {
+                if (ReadIntAt(probe[r], (2 * i + 1) * length[r] / (2 * m), &samples[count])) {
+                    count++;
+                }
+            }
+        }
+        QuickSort(samples, 0, count - 1);
+
+        for (int r = 0; r < k; r++) {
+            bounds[r] = 0;
+            bounds[(size_t)threads * k + r] = length[r];
+        }
+        for (int t = 1; t < threads; t++) {
+            int splitter = samples[(long long)t * count / threads];
+            for (int r = 0; r < k; r++) {
+                bounds[(size_t)t * k + r] = RunLowerBound(probe[r], length[r], splitter);
+            }
+        }
+    }
+    for (int r = 0; probe && r < k; r++) {
+        if (probe[r]) fclose(probe[r]);
+    }
+
+    // Too small to split: merge on this thread
+    if (ok && total < (long long)threads * EXTERNAL_SORT_MIN_BLOCK) {
+        free(length);
+        free(bounds);
+        free(probe);
+        free(samples);
+        return MergeRunGroupSerial(job, ids, k, output, block, 1);
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    MergeSlice *slices = (MergeSlice *)malloc(threads * sizeof(MergeSlice));
+    ok = ok && tids && slices;
+    int sliceBlock = block / threads > 1024 ? block / threads : 1024;
+    int started = 0;
+    for (int t = 0; ok && t < threads; t++) {
+        slices[t].job = job;
+        slices[t].ids = ids;
+        slices[t].k = k;
+        slices[t].output = output;
+        slices[t].block = sliceBlock;
+        slices[t].bounds = bounds + (size_t)t * k;
+        slices[t].ok = 0;
+    }
+    while (ok && started < threads && pthread_create(&tids[started], NULL, MergeSliceWorker, &slices[started]) == 0) {
+        started++;
+    }
+    // Slices without a thread run here
+    for (int t = started; ok && t < threads; t++) {
+        MergeSliceWorker(&slices[t]);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    for (int t = 0; ok && t < threads; t++) {
+        ok = slices[t].ok;
+    }
+    if (ok) {
+        externalSortStats.merges++;
+    }
+
+    free(tids);
+    free(slices);
+    free(length);
+    free(bounds);
+    free(probe);
+    free(samples);
+    return ok;
+}
+
+#ifdef EXTERNAL_SORT_MMAP
+
+static long long FileLength(FILE *file) {
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 ? (long long)st.st_size : -1;
+}
+
+static char *MapFile(FILE *file, long long bytes, int writable) {
+    void *base = mmap(NULL, (size_t)bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fileno(file), 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(base, (size_t)bytes, MADV_SEQUENTIAL);
+    return (char *)base;
+}
+
+/**
+ * Chunk runs without read or write calls
+ * Each chunk is copied from the mapped input into its mapped run file,
+ * sized up front with ftruncate, and sorted there
+ */
+static int GenerateMappedRuns(SortJob *job, FILE *input, int chunkSize) {
+    long long values = FileLength(input) / (long long)sizeof(int);
+    if (values <= 0) {
+        return values < 0 ? -1 : 0;
+    }
+    char *in = MapFile(input, values * (long long)sizeof(int), 0);
+    if (!in) {
+        return -1;
+    }
+
+    int runCount = 0;
+    long long released = 0;
+    for (long long position = job->inputOffset / (long long)sizeof(int); position < values; position += chunkSize) {
+        int count = values - position < chunkSize ? (int)(values - position) : chunkSize;
+        size_t bytes = count * sizeof(int);
+        int id;
+        FILE *runFile = CreateRunFile(job, &id);
+        char *run = NULL;
+        if (runFile && ftruncate(fileno(runFile), (off_t)bytes) == 0) {
+            run = MapFile(runFile, (long long)bytes, 1);
+        }
+        if (!run) {
+            if (runFile) fclose(runFile);
+            munmap(in, (size_t)(values * sizeof(int)));
+            return -1;
+        }
+
+        memcpy(run, in + position * sizeof(int), bytes);
+        QuickSort((int *)run, 0, count - 1);
+        munmap(run, bytes);
+        fclose(runFile);
+        ReleasePages(in, &released, (position + count) * (long long)sizeof(int));
+        STATS_ADD(bytesRead, bytes);
+        STATS_ADD(bytesWritten, bytes);
+        runCount++;
+    }
+
+    munmap(in, (size_t)(values * sizeof(int)));
+    return runCount;
+}
+
+/**
+ * Merge mapped runs ids[0..k) into a mapped output
+ * The output file is sized to the sum of the runs; the loser tree reads
+ * from and writes into the mappings through block-sized windows
+ */
+static int MergeRunGroupMapped(SortJob *job, const int *ids, int k, FILE *output, int block) {
+    RunFile *runs = (RunFile *)calloc(k, sizeof(RunFile));
+    long long total = 0;
+    int opened = 0;
+    int ok = runs != NULL;
+
+    while (ok && opened < k) {
+        char filename[RUN_PATH_MAX];
+        RunFile *run = &runs[opened];
+        RunPath(job, ids[opened], filename);
+        run->file = fopen(filename, "rb");
+        run->mapped = (struct MappedRun *)calloc(1, sizeof(struct MappedRun));
+        if (!run->file || !run->mapped) {
+            printf("Cannot open run file: %s\n", filename);
+            if (run->file) fclose(run->file);
+            free(run->mapped);
+            ok = 0;
+            break;
+        }
+        opened++;
+        run->mapped->values = FileLength(run->file) / (long long)sizeof(int);
+        if (run->mapped->values > 0) {
+            run->mapped->base = MapFile(run->file, run->mapped->values * (long long)sizeof(int), 0);
+            ok = run->mapped->base != NULL;
+        }
+        run->capacity = block;
+        run->remaining = 0;
+        total += run->mapped->values;
+    }
+
+    OutputBuffer out;
+    out.mapBase = NULL;
+    if (ok && total > 0) {
+        ok = ftruncate(fileno(output), (off_t)(total * sizeof(int))) == 0 &&
+             (out.mapBase = MapFile(output, total * (long long)sizeof(int), 1)) != NULL;
+        if (ok) {
+            out.file = output;
+            out.buffer = (int *)out.mapBase;
+            out.capacity = total < block ? (int)total : block;
+            out.count = 0;
+            out.io = NULL;
+            out.back = NULL;
+            out.pending = 0;
+            out.positioned = 0;
+            out.mapValues = total;
+            out.mapPosition = 0;
+            out.released = 0;
+            out.error = 0;
+            ok = MergeToBuffer(runs, k, &out, job->dropConsumed ? job : NULL, ids);
+            munmap(out.mapBase, (size_t)(total * sizeof(int)));
+        }
+    }
+    if (ok) {
+        externalSortStats.merges++;
+    }
+
+    for (int i = 0; i < opened; i++) {
+        CloseRunFile(&runs[i]);
+    }
+    free(runs);
+    return ok;
+}
+
+#endif
+
+/**
+ * One record in a sort index or at the head of a run
+ * prefix is the first 8 key bytes, big-endian and zero padded, so most
+ * comparisons are a single integer compare
+ */
+typedef struct {
+    unsigned long long prefix;
+    const char *record;
+    int length;
+    int keyStart;
+    int keyLength;
+} RecordEntry;
+
+static void MakeRecordEntry(RecordEntry *entry, const RecordLayout *layout, const char *record, int length) {
+    int keyStart = layout->keyOffset < length ? layout->keyOffset : length;
+    int keyLength = length - keyStart;
+    if (layout->keyLength > 0 && layout->keyLength < keyLength) {
+        keyLength = layout->keyLength;
+    }
+    const unsigned char *key = (const unsigned char *)record + keyStart;
+    unsigned long long prefix = 0;
+    for (int i = 0; i < 8 && i < keyLength; i++) {
+        prefix |= (unsigned long long)key[i] << (56 - 8 * i);
+    }
+    entry->prefix = prefix;
+    entry->record = record;
+    entry->length = length;
+    entry->keyStart = keyStart;
+    entry->keyLength = keyLength;
+}
+
+// memcmp order of the keys, a key before its extensions
+static int CompareRecordKeys(const RecordEntry *a, const RecordEntry *b) {
+    if (a->prefix != b->prefix) {
+        return a->prefix < b->prefix ? -1 : 1;
+    }
+    // Equal prefixes: the first min(8, length) key bytes are equal
+    int n = a->keyLength < b->keyLength ? a->keyLength : b->keyLength;
+    if (n > 8) {
+        int c = memcmp(a->record + a->keyStart + 8, b->record + b->keyStart + 8, n - 8);
+        if (c != 0) {
+            return c;
+        }
+    }
+    return (a->keyLength > b->keyLength) - (a->keyLength < b->keyLength);
+}
+
+#define RECORD_ENTRY_LESS(x, y) \
+    ((x).prefix != (y).prefix ? (x).prefix < (y).prefix : CompareRecordKeys(&(x), &(y)) < 0)
+SORT_EX_DEFINE(SortRecordEntries, RecordEntry, RECORD_ENTRY_LESS)
+
+/**
+ * Cut the next record from data[*position..size)
+ * A line without a newline only counts at the end of the input
+ *
+ * @return 1 with the record in entry, 0 if no whole record is left
+ */
+static int CutRecord(const RecordLayout *layout, const char *data, int *position, int size, int atEnd,
+                     RecordEntry *entry) {
+    int available = size - *position;
+    const char *record = data + *position;
+    if (layout->format == RECORDS_FIXED) {
+        if (available < layout->recordSize) {
+            return 0;
+        }
+        MakeRecordEntry(entry, layout, record, layout->recordSize);
+        *position += layout->recordSize;
+        return 1;
+    }
+    const char *newline = (const char *)memchr(record, '\n', available);
+    if (newline) {
+        MakeRecordEntry(entry, layout, record, (int)(newline - record));
+        *position += (int)(newline - record) + 1;
+        return 1;
+    }
+    if (atEnd && available > 0) {
+        MakeRecordEntry(entry, layout, record, available);
+        *position = size;
+        return 1;
+    }
+    return 0;
+}
+
+// Write one record; lines always end with a newline
+static void WriteRecord(FILE *file, const RecordLayout *layout, const RecordEntry *entry) {
+    fwrite(entry->record, 1, entry->length, file);
+    STATS_ADD(bytesWritten, entry->length);
+    if (layout->format == RECORDS_LINES) {
+        fputc('\n', file);
+        STATS_ADD(bytesWritten, 1);
+    }
+}
+
+// Grow a record buffer that cannot hold one whole record
+static char *GrowRecordBuffer(char *buffer, int *capacity) {
+    if (*capacity > INT_MAX / 2) {
+        return NULL;
+    }
+    char *grown = (char *)realloc(buffer, (size_t)*capacity * 2);
+    if (grown) {
+        *capacity *= 2;
+    }
+    return grown;
+}
+
+/**
+ * Record runs
+ * The chunk is filled with whole records, an index of prefixes and
+ * pointers is sorted, and the records are written in index order. A
+ * partial record at the end of the chunk moves to the front of the next.
+ *
+ * @param job Run naming and record layout
+ * @param input Input file
+ * @param dataBytes Chunk size in bytes
+ * @param maxEntries Index size, the most records per run
+ * @return Number of runs created, or -1 on error
+ */
+static int GenerateRecordRuns(SortJob *job, FILE *input, int dataBytes, int maxEntries) {
+    const RecordLayout *layout = job->records;
+    char *data = (char *)malloc(dataBytes);
+    RecordEntry *entries = (RecordEntry *)malloc((size_t)maxEntries * sizeof(RecordEntry));
+    if (!data || !entries) {
+        free(data);
+        free(entries);
+        return -1;
+    }
+
+    int size = 0;
+    int runCount = 0;
+    for (;;) {
+        size_t got = fread(data + size, 1, dataBytes - size, input);
+        STATS_ADD(bytesRead, got);
+        size += (int)got;
+        int atEnd = feof(input) || ferror(input);
+
+        int position = 0, n = 0;
+        while (n < maxEntries && CutRecord(layout, data, &position, size, atEnd, &entries[n])) {
+            n++;
+        }
+        if (n == 0) {
+            if (atEnd) {
+                break;
+            }
+            // A record longer than the chunk: make room for it
+            char *grown = GrowRecordBuffer(data, &dataBytes);
+            if (!grown) {
+                runCount = -1;
+                break;
+            }
+            data = grown;
+            continue;
+        }
+
+        SortRecordEntries(entries, n);
+        int id;
+        FILE *runFile = CreateRunFile(job, &id);
+        if (!runFile) {
+            runCount = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            WriteRecord(runFile, layout, &entries[i]);
+        }
+        int written = !ferror(runFile);
+        if (fclose(runFile) != 0 || !written) {
+            printf("Cannot write run file %d\n", id);
+            runCount = -1;
+            break;
+        }
+        runCount++;
+
+        memmove(data, data + position, size - position);
+        size -= position;
+    }
+
+    if (runCount >= 0 && size > 0) {
+        printf("Input ends with a partial record of %d bytes\n", size);
+        runCount = -1;
+    }
+    free(data);
+    free(entries);
+    return runCount;
+}
+
+/**
+ * A record run being merged
+ * buffer[start..end) is read but not yet consumed; head is the current
+ * record and points into buffer. error is set when the run ended early:
+ * a read error, a partial record at its end or no memory for a record
+ */
+typedef struct {
+    FILE *file;
+    char *buffer;
+    int capacity;
+    int start;
+    int end;
+    int atEnd;
+    int exhausted;
+    int error;
+    RecordEntry head;
+} RecordRun;
+
+// Load the next record of a run into head; 0 once the run is exhausted
+static int NextRecord(RecordRun *run, const RecordLayout *layout) {
+    for (;;) {
+        if (CutRecord(layout, run->buffer, &run->start, run->end, run->atEnd, &run->head)) {
+            return 1;
+        }
+        if (run->atEnd) {
+            if (run->start != run->end || ferror(run->file)) {
+                run->error = 1;
+            }
+            return 0;
+        }
+        memmove(run->buffer, run->buffer + run->start, run->end - run->start);
+        run->end -= run->start;
+        run->start = 0;
+        if (run->end == run->capacity) {
+            char *grown = GrowRecordBuffer(run->buffer, &run->capacity);
+            if (!grown) {
+                run->error = 1;
+                return 0;
+            }
+            run->buffer = grown;
+        }
+        size_t got = fread(run->buffer + run->end, 1, run->capacity - run->end, run->file);
+        STATS_ADD(bytesRead, got);
+        run->end += (int)got;
+        run->atEnd = got == 0;
+    }
+}
+
+// Loser tree order over run indices: -1 is -infinity, exhausted runs +infinity
+static int RecordRunBeats(const RecordRun *runs, int a, int b) {
+    if (a < 0) return 1;
+    if (b < 0) return 0;
+    if (runs[a].exhausted) return 0;
+    if (runs[b].exhausted) return 1;
+    int c = CompareRecordKeys(&runs[a].head, &runs[b].head);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static void ReplayRecordTree(int *tree, const RecordRun *runs, int k, int r) {
+    for (int t = (r + k) / 2; t > 0; t /= 2) {
+        if (RecordRunBeats(runs, tree[t], r)) {
+            int temp = tree[t];
+            tree[t] = r;
+            r = temp;
+        }
+    }
+    tree[0] = r;
+}
+
+/**
+ * Merge record runs ids[0..k) into output with a loser tree of run indices
+ *
+ * @param block Read buffer per run and output stream buffer, in bytes
+ */
+static int MergeRecordGroup(SortJob *job, const int *ids, int k, FILE *output, int block) {
+    const RecordLayout *layout = job->records;
+    RecordRun *runs = (RecordRun *)calloc(k, sizeof(RecordRun));
+    int *tree = (int *)malloc(k * sizeof(int));
+    int opened = 0;
+    int ok = runs && tree && setvbuf(output, NULL, _IOFBF, block) == 0;
+
+    while (ok && opened < k) {
+        char filename[RUN_PATH_MAX];
+        RecordRun *run = &runs[opened];
+        RunPath(job, ids[opened], filename);
+        run->file = fopen(filename, "rb");
+        run->buffer = (char *)malloc(block);
+        if (!run->file || !run->buffer) {
+            printf("Cannot open run file: %s\n", filename);
+            if (run->file) fclose(run->file);
+            free(run->buffer);
+            ok = 0;
+            break;
+        }
+        run->capacity = block;
+        run->exhausted = !NextRecord(run, layout);
+        opened++;
+    }
+
+    if (ok) {
+        for (int t = 0; t < k; t++) {
+            tree[t] = -1;
+        }
+        for (int i = k - 1; i >= 0; i--) {
+            ReplayRecordTree(tree, runs, k, i);
+        }
+        while (!runs[tree[0]].exhausted) {
+            int r = tree[0];
+            WriteRecord(output, layout, &runs[r].head);
+            runs[r].exhausted = !NextRecord(&runs[r], layout);
+            ReplayRecordTree(tree, runs, k, r);
+        }
+        ok = fflush(output) == 0 && !ferror(output);
+        externalSortStats.merges++;
+    }
+    // A run cut short leaves its tail out of the merge
+    for (int i = 0; i < opened; i++) {
+        if (runs[i].error) {
+            ok = 0;
+        }
+    }
+
+    for (int i = 0; i < opened; i++) {
+        fclose(runs[i].file);
+        free(runs[i].buffer);
+    }
+    free(runs);
+    free(tree);
+    return ok;
+}
+
+/**
+ * Merge runs ids[0..k) into output, in parallel when the job has threads
+ * Splitting needs random access into the runs, so compressed runs are
+ * always merged on one thread
+ */
+static int MergeRunGroup(SortJob *job, const int *ids, int k, FILE *output, int block, int toRun) {
+    if (job->records) {
+        return MergeRecordGroup(job, ids, k, output, block);
+    }
+#ifdef EXTERNAL_SORT_MMAP
+    if (job->mapped) {
+        return MergeRunGroupMapped(job, ids, k, output, block);
+    }
+#endif
+    if (job->threads > 1 && k > 1 && !job->compress) {
+        return MergeRunGroupParallel(job, ids, k, output, block);
+    }
+    return MergeRunGroupSerial(job, ids, k, output, block, toRun);
+}
+
+/**
+ * Live runs of a job in merge order
+ * Merges take runs from the head and append their output at the tail
+ */
+typedef struct {
+    int *ids;
+    int head;
+    int tail;
+    int merges;
+} RunQueue;
+
+static int InitRunQueue(RunQueue *queue, int runCount) {
+    queue->ids = (int *)malloc((2 * runCount + 1) * sizeof(int));
+    queue->head = 0;
+    queue->tail = 0;
+    queue->merges = 0;
+    for (int i = 0; queue->ids && i < runCount; i++) {
+        queue->ids[queue->tail++] = i;
+    }
+    return queue->ids != NULL;
+}
+
+// Account for a merge of the k runs at the head into run id
+static int QueueMerged(RunQueue *queue, int id, int k) {
+    if (k < 2 || k > queue->tail - queue->head) {
+        return 0;
+    }
+    queue->head += k;
+    queue->ids[queue->tail++] = id;
+    queue->merges++;
+    return 1;
+}
+
+/**
+ * Phase 2: merge the queued runs into outputFile, fanIn at a time, in
+ * the FIFO order described at ExternalSortEx
+ * Every merge is logged before its input runs are deleted
+ *
+ * @param job Run naming and merge mode
+ * @param queue Live runs; merges already done are skipped
+ * @param fanIn Most runs merged at once, at least 2
+ * @param block Buffer size per run and for the output
+ * @param outputFile Path to output file
+ * @return 1 on success, 0 on failure
+ */
+static int MergeAllRuns(SortJob *job, RunQueue *queue, int fanIn, int block, const char *outputFile) {
+    int ok = 1;
+    // A pass ends once the runs that were live at its start are all merged
+    int passStart = queue->head, passEnd = queue->tail;
+    while (queue->tail - queue->head > fanIn) {
+        int live = queue->tail - queue->head;
+        int k = queue->merges == 0 ? (live - 2) % (fanIn - 1) + 2 : fanIn;
+        int id;
+        FILE *runFile = CreateRunFile(job, &id);
+        if (!runFile) {
+            ok = 0;
+            break;
+        }
+        ok = MergeRunGroup(job, queue->ids + queue->head, k, runFile, block, 1);
+        if (fclose(runFile) != 0) {
+            ok = 0;
+        }
+        if (!ok) {
+            printf("Cannot write run file %d\n", id);
+            RemoveRuns(job, &id, 1);
+            break;
+        }
+        LogProgress(job, "merge %d %d\n", id, k);
+        RemoveRuns(job, queue->ids + queue->head, k);
+        QueueMerged(queue, id, k);
+        if (queue->head >= passEnd) {
+            externalSortStats.mergePasses++;
+            passStart = passEnd;
+            passEnd = queue->tail;
+        }
+    }
+    // Intermediate merges of an unfinished pass count as a pass of their own
+    if (queue->head > passStart) {
+        externalSortStats.mergePasses++;
+    }
+
+    if (ok) {
+        FILE *output = fopen(outputFile, job->mapped ? "w+b" : "wb");
+        if (!output) {
+            printf("Cannot create output file: %s\n", outputFile);
+            ok = 0;
+        } else {
+            // An empty input leaves no runs and an empty output
+            if (queue->tail > queue->head) {
+                ok = MergeRunGroup(job, queue->ids + queue->head, queue->tail - queue->head, output, block, 0);
+                externalSortStats.mergePasses++;
+            }
+            if (fclose(output) != 0) {
+                ok = 0;
+            }
+            // Never leave a truncated output behind
+            if (!ok) {
+                printf("Cannot write output file: %s\n", outputFile);
+                remove(outputFile);
+            }
+        }
+    }
+    return ok;
+}
+
+#define MANIFEST_NAME "manifest.txt"
+
+#ifdef _WIN32
+#define MakeDir(path) _mkdir(path)
+#define RemoveDir(path) _rmdir(path)
+#define ProcessId() _getpid()
+#else
+#define MakeDir(path) mkdir(path, 0700)
+#define RemoveDir(path) rmdir(path)
+#define ProcessId() getpid()
+#endif
+
+static int jobCounter;
+
+static void ManifestPath(const SortJob *job, char *path) {
+    snprintf(path, RUN_PATH_MAX, "%s/%s", job->tempDir, MANIFEST_NAME);
+}
+
+/**
+ * Pick the directory of a job
+ * A named job directory is created if missing and kept for resuming;
+ * otherwise a fresh extsort_<pid>_<n> directory is made under tempDir,
+ * so concurrent sorts never share run files
+ *
+ * @param cfg Settings (tempDir, jobDir)
+ * @param path Receives the directory, RUN_PATH_MAX bytes
+ * @return 1 on success, 0 on failure
+ */
+static int OpenJobDir(const ExternalSortConfig *cfg, char *path) {
+    if (cfg->jobDir) {
+        snprintf(path, RUN_PATH_MAX, "%s", cfg->jobDir);
+        if (MakeDir(path) == 0 || errno == EEXIST) {
+            return 1;
+        }
+    } else {
+        const char *parent = cfg->tempDir ? cfg->tempDir : ".";
+        for (int attempt = 0; attempt < 1000; attempt++) {
+#ifdef __GNUC__
+            int n = __atomic_fetch_add(&jobCounter, 1, __ATOMIC_RELAXED);
+#else
+            int n = jobCounter++;
+#endif
+            snprintf(path, RUN_PATH_MAX, "%s/extsort_%d_%d", parent, (int)ProcessId(), n);
+            if (MakeDir(path) == 0) {
+                return 1;
+            }
+            if (errno != EEXIST) {
+                break;
+            }
+        }
+    }
+    printf("Cannot create job directory: %s\n", path);
+    return 0;
+}
+
+// Remove the manifest and the job directory once it holds no runs
+static void CloseJobDir(SortJob *job) {
+    char filename[RUN_PATH_MAX];
+    if (job->manifest) {
+        fclose(job->manifest);
+        job->manifest = NULL;
+    }
+    ManifestPath(job, filename);
+    remove(filename);
+    RemoveDir(job->tempDir);
+}
+
+/**
+ * Progress of an interrupted job, read back from its manifest
+ * runs[0..runsDone) cover the input up to inputOffset; runCount is -1
+ * until run generation finished; merges holds (run id, k) pairs; runs
+ * from nextRun on were never logged
+ */
+typedef struct {
+    int runsDone;
+    long long inputOffset;
+    int runCount;
+    int *merges;
+    int mergeCount;
+    int nextRun;
+} JobProgress;
+
+static int RunExists(const SortJob *job, int id) {
+    char filename[RUN_PATH_MAX];
+    RunPath(job, id, filename);
+    FILE *file = fopen(filename, "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != NULL;
+}
+
+/**
+ * First manifest line: the input's size, device, inode and modification
+ * time and the run format. The size alone would let a crashed job resume
+ * on a different input of the same size and merge its stale runs
+ *
+ * @return 1 on success, 0 if the input cannot be identified
+ */
+static int JobHeader(FILE *input, int compress, char *header, size_t size) {
+    struct stat st;
+    if (fstat(fileno(input), &st) != 0) {
+        return 0;
+    }
+    snprintf(header, size, "extsort %lld %d %lld %lld %lld\n", (long long)st.st_size, compress,
+             (long long)st.st_dev, (long long)st.st_ino, (long long)st.st_mtime);
+    return 1;
+}
+
+/**
+ * Read the manifest of a job directory
+ * The first line identifies the input and run format; progress is only
+ * used if it matches and every run it leaves alive is still on disk
+ *
+ * @return 1 if the job can resume from progress, 0 to start over
+ */
+static int LoadManifest(const SortJob *job, const char *header, JobProgress *progress) {
+    char filename[RUN_PATH_MAX];
+    char line[256];
+    progress->runsDone = 0;
+    progress->inputOffset = 0;
+    progress->runCount = -1;
+    progress->merges = NULL;
+    progress->mergeCount = 0;
+    progress->nextRun = 0;
+
+    ManifestPath(job, filename);
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        return 0;
+    }
+    int ok = fgets(line, sizeof(line), file) && strcmp(line, header) == 0;
+    int capacity = 0;
+    while (ok && fgets(line, sizeof(line), file)) {
+        int id, k;
+        long long offset;
+        if (sscanf(line, "run %d %lld", &id, &offset) == 2) {
+            if (id >= progress->runsDone && progress->runCount < 0) {
+                progress->runsDone = id + 1;
+                progress->inputOffset = offset;
+            }
+        } else if (sscanf(line, "runs %d", &k) == 1) {
+            progress->runCount = k;
+            id = k - 1;
+        } else if (sscanf(line, "merge %d %d", &id, &k) == 2) {
+            if (progress->mergeCount == capacity) {
+                capacity = capacity ? 2 * capacity : 16;
+                int *grown = (int *)realloc(progress->merges, 2 * capacity * sizeof(int));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                progress->merges = grown;
+            }
+            progress->merges[2 * progress->mergeCount] = id;
+            progress->merges[2 * progress->mergeCount + 1] = k;
+            progress->mergeCount++;
+        } else {
+            continue;
+        }
+        if (id + 1 > progress->nextRun) {
+            progress->nextRun = id + 1;
+        }
+    }
+    fclose(file);
+
+    // Every run the recorded progress leaves alive must still exist
+    if (ok && progress->runCount < 0) {
+        for (int i = 0; ok && i < progress->runsDone; i++) {
+            ok = RunExists(job, i);
+        }
+    } else if (ok) {
+        RunQueue queue;
+        ok = InitRunQueue(&queue, progress->runCount);
+        for (int m = 0; ok && m < progress->mergeCount; m++) {
+            ok = QueueMerged(&queue, progress->merges[2 * m], progress->merges[2 * m + 1]);
+        }
+        for (int i = queue.head; ok && i < queue.tail; i++) {
+            ok = RunExists(job, queue.ids[i]);
+        }
+        free(queue.ids);
+    }
+    return ok;
+}
+
+/**
+ * External sort with a memory budget
+ * Run generation uses the whole budget: quicksort chunks hold
+ * memoryBytes / 4 values, the replacement selection heap the same less
+ * its input and output blocks. Merging gives every input run and the
+ * output an equal block of at least EXTERNAL_SORT_MIN_BLOCK values,
+ * which bounds the fan-in. Pipelined I/O needs two of every buffer, so
+ * chunks and blocks are half as large. With threads, every thread sorts
+ * its own chunk of memoryBytes / threads and the merge blocks are shared
+ * between the threads; parallel phases use blocking I/O on each thread.
+ * The mmap mode runs on one thread; there the merge block is the window
+ * after which consumed pages are dropped. Compressed runs are merged on
+ * one thread with blocking reads; the mmap mode ignores compression.
+ * With more runs than that, runs are merged in FIFO order; the first
+ * merge takes just enough runs that every later merge is full width,
+ * which minimizes the data written in intermediate passes.
+ * Runs live in a directory of their own. With cfg->jobDir the manifest
+ * there logs each run and merge once its file is complete; rerunning the
+ * same sort with the same jobDir after a crash skips the logged work.
+ * Chunk runs on one thread are logged one by one, other run generation
+ * only as a whole. Dropping consumed runs frees disk space during a merge
+ * but a crash in that merge then restarts the job.
+ *
+ * @param inputFile Path to input file
+ * @param outputFile Path to output file
+ * @param cfg Settings, or NULL for ExternalSortDefaultConfig
+ * @return 1 on success, 0 on failure
+ */
+int ExternalSortEx(const char *inputFile, const char *outputFile, const ExternalSortConfig *cfg) {
+    ExternalSortConfig defaults;
+    if (!cfg) {
+        ExternalSortDefaultConfig(&defaults);
+        cfg = &defaults;
+    }
+
+    size_t budget = cfg->memoryBytes / sizeof(int);
+    if (budget < 4 * EXTERNAL_SORT_MIN_BLOCK) {
+        budget = 4 * EXTERNAL_SORT_MIN_BLOCK;
+    }
+    if (budget > INT_MAX) {
+        budget = INT_MAX;
+    }
+    int ioBlock = (int)(budget / 64);
+    if (ioBlock < EXTERNAL_SORT_MIN_BLOCK) ioBlock = EXTERNAL_SORT_MIN_BLOCK;
+    if (ioBlock > EXTERNAL_SORT_MAX_BLOCK) ioBlock = EXTERNAL_SORT_MAX_BLOCK;
+    // Up to four I/O blocks must leave at least half the budget for the heap
+    if (ioBlock > (int)(budget / 8)) ioBlock = (int)(budget / 8);
+
+    char jobDir[RUN_PATH_MAX];
+    if (!OpenJobDir(cfg, jobDir)) {
+        return 0;
+    }
+    SortJob job;
+    InitSortJob(&job, jobDir, ioBlock);
+    job.dropConsumed = cfg->dropConsumedRuns;
+    int copies = 1;
+    if (cfg->io == EXTERNAL_IO_MMAP) {
+#ifdef EXTERNAL_SORT_MMAP
+        job.mapped = 1;
+#endif
+    } else if (cfg->io != EXTERNAL_IO_BLOCKING) {
+        job.io = AsyncIoCreate(cfg->io == EXTERNAL_IO_URING ? ASYNC_IO_URING : ASYNC_IO_THREAD);
+        copies = job.io ? 2 : 1;
+    }
+    if (cfg->threads > 1) {
+        job.threads = cfg->threads;
+    }
+    job.compress = cfg->compressRuns && !job.mapped;
+
+    FILE *input = fopen(inputFile, "rb");
+    if (!input) {
+        printf("Cannot open input file: %s\n", inputFile);
+        AsyncIoDestroy(job.io);
+        CloseJobDir(&job);
+        return 0;
+    }
+
+    // A named job directory resumes from its manifest or starts a new one
+    JobProgress progress;
+    int resumed = 0;
+    progress.runsDone = 0;
+    progress.inputOffset = 0;
+    progress.runCount = -1;
+    progress.merges = NULL;
+    progress.mergeCount = 0;
+    if (cfg->jobDir) {
+        char header[128];
+        char filename[RUN_PATH_MAX];
+        if (!JobHeader(input, job.compress, header, sizeof(header))) {
+            printf("Cannot identify input file: %s\n", inputFile);
+            fclose(input);
+            AsyncIoDestroy(job.io);
+            CloseJobDir(&job);
+            return 0;
+        }
+        resumed = LoadManifest(&job, header, &progress);
+        if (!resumed) {
+            RemoveRuns(&job, NULL, progress.nextRun);
+            progress.runsDone = 0;
+            progress.inputOffset = 0;
+            progress.runCount = -1;
+            progress.mergeCount = 0;
+        } else {
+            // The run being written when the job stopped
+            RemoveRuns(&job, &progress.nextRun, 1);
+        }
+        ManifestPath(&job, filename);
+        job.manifest = fopen(filename, resumed ? "a" : "w");
+        // A named job that cannot log its progress would not resume; the
+        // directory is left as it is, runs of a resumable job included
+        if (!job.manifest) {
+            printf("Cannot open job manifest: %s\n", filename);
+            fclose(input);
+            free(progress.merges);
+            AsyncIoDestroy(job.io);
+            return 0;
+        }
+        if (!resumed) {
+            LogProgress(&job, "%s", header);
+        }
+    }
+
+    // Phase 1: runs, continuing after the logged ones
+    double start = PhaseClock();
+    int runCount = progress.runCount;
+    if (runCount < 0) {
+        job.nextRun = progress.runsDone;
+        job.inputOffset = progress.inputOffset;
+        SeekFile(input, job.inputOffset, SEEK_SET);
+    }
+    if (runCount >= 0) {
+        job.nextRun = progress.nextRun;
+    } else if (cfg->runGeneration == RUNS_REPLACEMENT_SELECTION) {
+        runCount = GenerateHeapRuns(&job, input, (int)(budget - 2 * copies * ioBlock));
+#ifdef EXTERNAL_SORT_MMAP
+    } else if (job.mapped) {
+        // Chunks are sorted inside the mapped run files
+        runCount = GenerateMappedRuns(&job, input, (int)budget);
+#endif
+    } else {
+        int *chunk = (int *)malloc(budget * sizeof(int));
+        if (!chunk) {
+            runCount = -1;
+        } else if (job.threads > 1) {
+            runCount = GenerateChunkRunsParallel(&job, input, chunk, (int)(budget / job.threads));
+        } else {
+            runCount = GenerateChunkRuns(&job, input, chunk, (int)(budget / copies), QuickSort);
+        }
+        free(chunk);
+    }
+    fclose(input);
+    if (runCount < 0) {
+        RemoveRuns(&job, NULL, job.nextRun);
+        free(progress.merges);
+        AsyncIoDestroy(job.io);
+        CloseJobDir(&job);
+        return 0;
+    }
+    if (progress.runCount < 0) {
+        runCount += progress.runsDone;
+        LogProgress(&job, "runs %d\n", runCount);
+    }
+    externalSortStats.runs = runCount;
+
+    // Phase 2: fan-in and block size from the budget
+    budget /= copies;
+    int fanIn = (int)(budget / EXTERNAL_SORT_MIN_BLOCK) - 1;
+    int maxFanIn = cfg->maxFanIn > 0 ? cfg->maxFanIn : EXTERNAL_SORT_MAX_FAN_IN;
+    if (fanIn > maxFanIn) fanIn = maxFanIn;
+    // Every merging thread opens each run of the merge
+    if (job.threads > 1 && fanIn > EXTERNAL_SORT_MAX_FAN_IN / job.threads) {
+        fanIn = EXTERNAL_SORT_MAX_FAN_IN / job.threads;
+    }
+    if (fanIn < 2) fanIn = 2;
+    int block = (int)(budget / (fanIn + 1));
+    if (block > EXTERNAL_SORT_MAX_BLOCK) block = EXTERNAL_SORT_MAX_BLOCK;
+
+    start = EndRunPhase(start);
+    RunQueue queue;
+    int ok = InitRunQueue(&queue, runCount);
+    if (ok) {
+        for (int m = 0; m < progress.mergeCount; m++) {
+            QueueMerged(&queue, progress.merges[2 * m], progress.merges[2 * m + 1]);
+        }
+        ok = MergeAllRuns(&job, &queue, fanIn, block, outputFile);
+        RemoveRuns(&job, queue.ids + queue.head, queue.tail - queue.head);
+        free(queue.ids);
+    } else {
+        RemoveRuns(&job, NULL, job.nextRun);
+    }
+    externalSortStats.mergeSeconds = PhaseClock() - start;
+    free(progress.merges);
+    AsyncIoDestroy(job.io);
+    CloseJobDir(&job);
+    return ok;
+}
+
+/**
+ * External sort of records by a byte key
+ * Run generation splits the budget between chunk data and the index (one
+ * RecordEntry per record) in proportion to the record size; merges give
+ * every run and the output a buffer of at least EXTERNAL_SORT_MIN_BLOCK
+ * ints worth of bytes. Runs go to a fresh directory under tempDir; only
+ * memoryBytes, tempDir and maxFanIn of cfg are used.
+ *
+ * @param inputFile Path to input file
+ * @param outputFile Path to output file
+ * @param layout Record format and key position
+ * @param cfg Settings, or NULL for ExternalSortDefaultConfig
+ * @return 1 on success, 0 on failure
+ */
+int ExternalSortRecords(const char *inputFile, const char *outputFile, const RecordLayout *layout,
+                        const ExternalSortConfig *cfg) {
+    ExternalSortConfig defaults;
+    if (!cfg) {
+        ExternalSortDefaultConfig(&defaults);
+        cfg = &defaults;
+    }
+    if (layout->keyOffset < 0 || layout->keyLength < 0 ||
+        (layout->format == RECORDS_FIXED &&
+         (layout->recordSize <= 0 || layout->keyOffset + layout->keyLength > layout->recordSize))) {
+        printf("Invalid record layout\n");
+        return 0;
+    }
+
+    size_t minBlock = EXTERNAL_SORT_MIN_BLOCK * sizeof(int);
+    size_t budget = cfg->memoryBytes;
+    if (budget < 4 * minBlock) budget = 4 * minBlock;
+    if (budget > INT_MAX) budget = INT_MAX;
+
+    // Record sorts do not resume: a fresh directory keeps the runs and
+    // manifest of an interrupted job in cfg->jobDir out of harm's way
+    ExternalSortConfig fresh = *cfg;
+    fresh.jobDir = NULL;
+    char jobDir[RUN_PATH_MAX];
+    if (!OpenJobDir(&fresh, jobDir)) {
+        return 0;
+    }
+    SortJob job;
+    InitSortJob(&job, jobDir, (int)minBlock);
+    job.records = layout;
+
+    FILE *input = fopen(inputFile, "rb");
+    if (!input) {
+        printf("Cannot open input file: %s\n", inputFile);
+        CloseJobDir(&job);
+        return 0;
+    }
+    // Split the chunk so data and index fill up together; lines assume 32 bytes
+    size_t recordBytes = layout->format == RECORDS_FIXED ? (size_t)layout->recordSize : 32;
+    size_t dataBytes = (size_t)((double)budget * recordBytes / (recordBytes + sizeof(RecordEntry)));
+    if (dataBytes < minBlock) dataBytes = minBlock;
+    int maxEntries = (int)((budget - dataBytes) / sizeof(RecordEntry));
+    if (maxEntries < 1) maxEntries = 1;
+    double start = PhaseClock();
+    int runCount = GenerateRecordRuns(&job, input, (int)dataBytes, maxEntries);
+    fclose(input);
+    if (runCount < 0) {
+        RemoveRuns(&job, NULL, job.nextRun);
+        CloseJobDir(&job);
+        return 0;
+    }
+    externalSortStats.runs = runCount;
+
+    int fanIn = (int)(budget / minBlock) - 1;
+    int maxFanIn = cfg->maxFanIn > 0 ? cfg->maxFanIn : EXTERNAL_SORT_MAX_FAN_IN;
+    if (fanIn > maxFanIn) fanIn = maxFanIn;
+    if (fanIn < 2) fanIn = 2;
+    size_t block = budget / (fanIn + 1);
+    if (block > EXTERNAL_SORT_MAX_BLOCK * sizeof(int)) block = EXTERNAL_SORT_MAX_BLOCK * sizeof(int);
+
+    start = EndRunPhase(start);
+    RunQueue queue;
+    int ok = InitRunQueue(&queue, runCount);
+    if (ok) {
+        ok = MergeAllRuns(&job, &queue, fanIn, (int)block, outputFile);
+        RemoveRuns(&job, queue.ids + queue.head, queue.tail - queue.head);
+        free(queue.ids);
+    } else {
+        RemoveRuns(&job, NULL, job.nextRun);
+    }
+    externalSortStats.mergeSeconds = PhaseClock() - start;
+    CloseJobDir(&job);
+    return ok;
+}
+
+/**
+ * Merge record runs run_0 .. run_<runCount - 1> of runDir into one output
+ * with MEMORY_BUFFER-int buffers; the runs are left in place
+ *
+ * @param runDir Directory holding the run files
+ * @param runCount Number of runs, at least 1
+ * @param outputFile Path to output file
+ * @param layout Record format and key position the runs are sorted by
+ * @return 1 on success, 0 if a run is missing, unreadable or cut short
+ */
+int MergeRecordRuns(const char *runDir, int runCount, const char *outputFile, const RecordLayout *layout) {
+    if (runCount < 1) {
+        return 0;
+    }
+    FILE *output = fopen(outputFile, "wb");
+    if (!output) {
+        printf("Cannot create output file: %s\n", outputFile);
+        return 0;
+    }
+    SortJob job;
+    InitSortJob(&job, runDir, MEMORY_BUFFER);
+    job.records = layout;
+    int *ids = (int *)malloc(runCount * sizeof(int));
+    int ok = ids != NULL;
+    for (int i = 0; ok && i < runCount; i++) {
+        ids[i] = i;
+    }
+    ok = ok && MergeRecordGroup(&job, ids, runCount, output, (int)(MEMORY_BUFFER * sizeof(int)));
+    if (fclose(output) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        remove(outputFile);
+    }
+    free(ids);
+    return ok;
 }
@@ -1,14 +1,17 @@
 #include "include/sort/heap_sort.h"
+#include "include/sort/sort_stats.h"
 
 void HeapAdjust(int *a, int k, int len) {
     int temp = a[k];
     for (int i = 2 * k + 1; i < len; i = 2 * i + 1) {
-        if (i + 1 < len && a[i] < a[i + 1]) i++;
-        if (temp >= a[i]) break;
+        if (i + 1 < len && SORT_CMP(a[i] < a[i + 1])) i++;
+        if (SORT_CMP(temp >= a[i])) break;
         a[k] = a[i];
+        SORT_MOVES(1);
         k = i;
     }
     a[k] = temp;
+    SORT_MOVES(1);
 }
 
 void HeapSort(int *a, int n) {
@@ -19,6 +22,7 @@ void HeapSort(int *a, int n) {
         int temp = a[0];
         a[0] = a[i];
         a[i] = temp;
+        SORT_MOVES(2);
         HeapAdjust(a, 0, i);
     }
 }
@@ -1,14 +1,16 @@
 #include "include/sort/insert_sort.h"
+#include "include/sort/sort_stats.h"
 
 void InsertSort(int *a, int n) {
     for (int i = 1; i < n; i++) {
-        if (a[i] < a[i - 1]) {
+        if (SORT_CMP(a[i] < a[i - 1])) {
             int temp = a[i];
             int j;
-            for (j = i - 1; j >= 0 && temp < a[j]; j--) {
+            for (j = i - 1; j >= 0 && SORT_CMP(temp < a[j]); j--) {
                 a[j + 1] = a[j];
             }
             a[j + 1] = temp;
+            SORT_MOVES(i - j);
         }
     }
 }
@@ -19,7 +21,7 @@ void BinaryInsertSort(int *a, int n) {
         int low = 0, high = i - 1;
         while (low <= high) {
             int mid = (low + high) / 2;
-            if (temp < a[mid]) {
+            if (SORT_CMP(temp < a[mid])) {
                 high = mid - 1;
             } else {
                 low = mid + 1;
@@ -29,5 +31,6 @@ void BinaryInsertSort(int *a, int n) {
             a[j + 1] = a[j];
         }
         a[high + 1] = temp;
+        SORT_MOVES(i - high);
     }
 }
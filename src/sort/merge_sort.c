@@ -1,34 +1,229 @@
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "include/sort/merge_sort.h"
+#include "include/sort/simd_sort.h"
+#include "include/sort/sort_stats.h"
 
-void Merge(int *a, int low, int mid, int high) {
-    int *b = (int *)malloc((high - low + 1) * sizeof(int));
-    int i = low, j = mid + 1, k = 0;
-    while (i <= mid && j <= high) {
-        if (a[i] <= a[j]) {
-            b[k++] = a[i++];
+#define MERGE_SORT_CUTOFF SIMD_BLOCK_MAX
+
+// Sort a[low..high] using b[low..high] as scratch
+static void MergeSortRange(int *a, int *b, int low, int high) {
+    if (high - low + 1 <= MERGE_SORT_CUTOFF) {
+        SortingNetwork(a + low, high - low + 1);
+        return;
+    }
+    int mid = low + (high - low) / 2;
+    MergeSortRange(a, b, low, mid);
+    MergeSortRange(a, b, mid + 1, high);
+    if (SORT_CMP(a[mid] <= a[mid + 1])) return;
+    MergeSortedArrays(a + low, mid - low + 1, a + mid + 1, high - mid, b + low);
+    memcpy(a + low, b + low, (high - low + 1) * sizeof(int));
+    SORT_MOVES(high - low + 1);
+}
+
+void MergeSort(int *a, int low, int high) {
+    if (low < high) {
+        int *b = (int *)malloc((high - low + 1) * sizeof(int));
+        MergeSortRange(a + low, b, 0, high - low);
+        free(b);
+    }
+}
+
+/*
+ * Parallel merge sort
+ *
+ * The array is cut into one chunk per thread and every chunk is sorted
+ * with MergeSortRange. Runs are then merged pairwise level by level,
+ * ping-ponging between the array and a single scratch buffer. Each pairwise
+ * merge is split along its merge path into segments of about n / threads
+ * outputs, so every level, including the final one, keeps all threads busy.
+ */
+
+typedef struct {
+    const int *src;
+    int *dst;
+    int low, mid, high;     // runs src[low..mid] and src[mid+1..high]
+    int first, last;        // output positions [first, last) relative to low
+} MergeTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    MergeTask *tasks;
+    int count;
+    int next;
+    int pending;
+    int shutdown;
+    int *a, *b;             // used by the run sorting phase
+    int sortPhase;
+} TaskPool;
+
+// Number of elements taken from A among the first diag outputs of a stable merge
+static int MergePathSplit(const int *A, int lenA, const int *B, int lenB, int diag) {
+    int lo = diag > lenB ? diag - lenB : 0;
+    int hi = diag < lenA ? diag : lenA;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (A[mid] <= B[diag - mid - 1]) {
+            lo = mid + 1;
         } else {
-            b[k++] = a[j++];
+            hi = mid;
         }
     }
-    while (i <= mid) {
-        b[k++] = a[i++];
+    return lo;
+}
+
+static void RunMergeTask(MergeTask *t) {
+    const int *A = t->src + t->low;
+    const int *B = t->src + t->mid + 1;
+    int lenA = t->mid - t->low + 1;
+    int lenB = t->high - t->mid;
+    int i = MergePathSplit(A, lenA, B, lenB, t->first);
+    int iEnd = MergePathSplit(A, lenA, B, lenB, t->last);
+    int j = t->first - i;
+    int jEnd = t->last - iEnd;
+    MergeSortedArrays(A + i, iEnd - i, B + j, jEnd - j, t->dst + t->low + t->first);
+}
+
+static void RunPoolTask(TaskPool *pool, int index) {
+    MergeTask *t = &pool->tasks[index];
+    if (pool->sortPhase) {
+        MergeSortRange(pool->a, pool->b, t->low, t->high);
+    } else {
+        RunMergeTask(t);
     }
-    while (j <= high) {
-        b[k++] = a[j++];
+}
+
+// Take and run tasks until the current batch is drained; called with the lock held
+static void DrainTasks(TaskPool *pool) {
+    while (pool->next < pool->count) {
+        int index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        RunPoolTask(pool, index);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
     }
-    for (int p = 0, q = low; p < k; p++, q++) {
-        a[q] = b[p];
+}
+
+static void *PoolWorker(void *arg) {
+    TaskPool *pool = (TaskPool *)arg;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->shutdown) {
+        DrainTasks(pool);
+        if (!pool->shutdown) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
     }
-    free(b);
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
 }
 
-void MergeSort(int *a, int low, int high) {
-    if (low < high) {
-        int mid = (low + high) / 2;
-        MergeSort(a, low, mid);
-        MergeSort(a, mid + 1, high);
-        Merge(a, low, mid, high);
+// Publish a batch of tasks, help run it and wait for all of it to finish
+static void RunBatch(TaskPool *pool, int count, int sortPhase) {
+    pthread_mutex_lock(&pool->lock);
+    pool->count = count;
+    pool->next = 0;
+    pool->pending = count;
+    pool->sortPhase = sortPhase;
+    pthread_cond_broadcast(&pool->work);
+    DrainTasks(pool);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
     }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void ParallelMergeSort(int *a, int n, int threads) {
+    if (n < 2) return;
+    if (threads < 1) threads = 1;
+    if (threads > n / MERGE_SORT_CUTOFF) threads = n / MERGE_SORT_CUTOFF;
+    if (threads < 1) threads = 1;
+
+    int *b = (int *)malloc(n * sizeof(int));
+    if (threads == 1) {
+        MergeSortRange(a, b, 0, n - 1);
+        free(b);
+        return;
+    }
+
+    TaskPool pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pool.tasks = (MergeTask *)malloc((2 * threads + 1) * sizeof(MergeTask));
+    pool.count = pool.next = pool.pending = 0;
+    pool.shutdown = 0;
+    pool.a = a;
+    pool.b = b;
+
+    pthread_t *workers = (pthread_t *)malloc((threads - 1) * sizeof(pthread_t));
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_create(&workers[i], NULL, PoolWorker, &pool);
+    }
+
+    // Phase 1: sort one chunk per thread
+    int runs = threads;
+    int *bounds = (int *)malloc((runs + 1) * sizeof(int));
+    for (int i = 0; i <= runs; i++) {
+        bounds[i] = (int)((long long)n * i / runs);
+    }
+    for (int i = 0; i < runs; i++) {
+        pool.tasks[i].low = bounds[i];
+        pool.tasks[i].high = bounds[i + 1] - 1;
+    }
+    RunBatch(&pool, runs, 1);
+
+    // Phase 2: merge pairs of runs level by level
+    int segment = (n + threads - 1) / threads;
+    const int *src = a;
+    int *dst = b;
+    while (runs > 1) {
+        int count = 0;
+        int merged = 0;
+        for (int r = 0; r < runs; r += 2) {
+            int low = bounds[r];
+            int mid = bounds[r + 1] - 1;
+            int high = (r + 1 < runs ? bounds[r + 2] : bounds[r + 1]) - 1;
+            int len = high - low + 1;
+            for (int first = 0; first < len; first += segment) {
+                MergeTask *t = &pool.tasks[count++];
+                t->src = src;
+                t->dst = dst;
+                t->low = low;
+                t->mid = mid;
+                t->high = high;
+                t->first = first;
+                t->last = first + segment < len ? first + segment : len;
+            }
+            bounds[merged++] = low;
+        }
+        bounds[merged] = n;
+        runs = merged;
+        RunBatch(&pool, count, 0);
+        src = dst;
+        dst = (dst == b) ? a : b;
+    }
+    if (src != a) {
+        memcpy(a, src, n * sizeof(int));
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.shutdown = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool.work);
+    pthread_cond_destroy(&pool.done);
+    pthread_mutex_destroy(&pool.lock);
+    free(workers);
+    free(bounds);
+    free(pool.tasks);
+    free(b);
 }
@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/sort/power_sort.h"
+#include "include/sort/heap_sort.h"
+#include "include/sort/simd_sort.h"
+
+/*
+ * Powersort: adaptive natural merge sort
+ *
+ * The array is scanned for existing runs; strictly descending runs are
+ * reversed and runs shorter than minrun are extended by inserting the
+ * following elements one by one from the end of the run, which costs
+ * little when they are almost in place. Runs go on a stack and are merged
+ * by the powersort rule: the power of the boundary between two
+ * neighbouring runs is the depth at which their midpoints fall into
+ * different halves of [0, n), and a boundary is merged before any new
+ * boundary with a smaller power.
+ *
+ * Merges trim the parts that are already in place and gallop once one
+ * side keeps winning. As in timsort the threshold for galloping adapts:
+ * it drops while galloping pays off and rises after it stops, so runs
+ * that interleave finely do not keep trying. Such runs, when of similar
+ * length, are merged with the vectorized MergeSortedArrays instead.
+ */
+
+#define POWER_SORT_MAX_STACK 64
+#define MIN_GALLOP 7
+#define VECTOR_MERGE_RATIO 4        // runs within this length ratio may use MergeSortedArrays
+
+typedef struct {
+    int *tmp;
+    int capacity;
+    int minGallop;
+} MergeState;
+
+typedef struct {
+    int start;
+    int len;
+    int power;              // power of the boundary between this run and the next
+} PowerRun;
+
+static int MinRunLength(int n) {
+    int r = 0;
+    while (n >= 64) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+// Grow a[0..len) to a sorted a[0..force) by straight insertion from the end
+static void ExtendRun(int *a, int len, int force) {
+    for (int i = len; i < force; i++) {
+        int temp = a[i];
+        int j = i;
+        while (j > 0 && temp < a[j - 1]) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = temp;
+    }
+}
+
+// Length of the run starting at lo; a strictly descending run is reversed in place
+static int CountRun(int *a, int lo, int hi) {
+    int i = lo + 1;
+    if (i == hi) return 1;
+    if (a[i] < a[lo]) {
+        while (i + 1 < hi && a[i + 1] < a[i]) i++;
+        for (int l = lo, r = i; l < r; l++, r--) {
+            int temp = a[l];
+            a[l] = a[r];
+            a[r] = temp;
+        }
+    } else {
+        while (i + 1 < hi && a[i + 1] >= a[i]) i++;
+    }
+    return i - lo + 1;
+}
+
+static int NodePower(int s1, int n1, int n2, int n) {
+    long long a = 2LL * s1 + n1;
+    long long b = a + n1 + n2;
+    int power = 0;
+    for (;;) {
+        power++;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        } else if (b >= n) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+    return power;
+}
+
+// Number of leading elements of a[0..n) that are <= key
+static int GallopUpper(const int *a, int n, int key) {
+    int lo = 0, hi = 1;
+    while (hi < n && a[hi - 1] <= key) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    if (hi > n) hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (a[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Number of leading elements of a[0..n) that are < key
+static int GallopLower(const int *a, int n, int key) {
+    int lo = 0, hi = 1;
+    while (hi < n && a[hi - 1] < key) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    if (hi > n) hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (a[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Merge a[s1..s1+n1) with a[s1+n1..s1+n1+n2) when n1 <= n2, copying the left run out
+static void MergeLo(int *a, int s1, int n1, int n2, MergeState *ms) {
+    int *tmp = ms->tmp;
+    int i = 0, j = s1 + n1, end = s1 + n1 + n2, k = s1;
+    int winsA = 0, winsB = 0;
+    memcpy(tmp, a + s1, n1 * sizeof(int));
+    while (i < n1 && j < end) {
+        if (a[j] < tmp[i]) {
+            a[k++] = a[j++];
+            winsB++;
+            winsA = 0;
+        } else {
+            a[k++] = tmp[i++];
+            winsA++;
+            winsB = 0;
+        }
+        if ((winsA >= ms->minGallop || winsB >= ms->minGallop) && i < n1 && j < end) {
+            int cA, cB = 0;
+            do {
+                cA = GallopUpper(tmp + i, n1 - i, a[j]);
+                memcpy(a + k, tmp + i, cA * sizeof(int));
+                k += cA;
+                i += cA;
+                if (i == n1) break;
+                cB = GallopLower(a + j, end - j, tmp[i]);
+                memmove(a + k, a + j, cB * sizeof(int));
+                k += cB;
+                j += cB;
+                if (j == end) break;
+                if (ms->minGallop > 1) ms->minGallop--;
+            } while (cA >= MIN_GALLOP || cB >= MIN_GALLOP);
+            ms->minGallop += 2;
+            winsA = winsB = 0;
+        }
+    }
+    memcpy(a + k, tmp + i, (n1 - i) * sizeof(int));
+}
+
+// Same merge from the back when n1 > n2, copying the right run out
+static void MergeHi(int *a, int s1, int n1, int n2, MergeState *ms) {
+    int *tmp = ms->tmp;
+    int *left = a + s1;
+    int i = n1 - 1, j = n2 - 1, k = s1 + n1 + n2 - 1;
+    int winsA = 0, winsB = 0;
+    memcpy(tmp, a + s1 + n1, n2 * sizeof(int));
+    while (i >= 0 && j >= 0) {
+        if (tmp[j] < left[i]) {
+            a[k--] = left[i--];
+            winsA++;
+            winsB = 0;
+        } else {
+            a[k--] = tmp[j--];
+            winsB++;
+            winsA = 0;
+        }
+        if ((winsA >= ms->minGallop || winsB >= ms->minGallop) && i >= 0 && j >= 0) {
+            int cA, cB = 0;
+            do {
+                cA = i + 1 - GallopUpper(left, i + 1, tmp[j]);
+                memmove(a + k - cA + 1, left + i - cA + 1, cA * sizeof(int));
+                k -= cA;
+                i -= cA;
+                if (i < 0) break;
+                cB = j + 1 - GallopLower(tmp, j + 1, left[i]);
+                memcpy(a + k - cB + 1, tmp + j - cB + 1, cB * sizeof(int));
+                k -= cB;
+                j -= cB;
+                if (j < 0) break;
+                if (ms->minGallop > 1) ms->minGallop--;
+            } while (cA >= MIN_GALLOP || cB >= MIN_GALLOP);
+            ms->minGallop += 2;
+            winsA = winsB = 0;
+        }
+    }
+    memcpy(a + s1, tmp, (j + 1) * sizeof(int));
+}
+
+static void MergeRuns(int *a, PowerRun *left, PowerRun *right, MergeState *ms) {
+    int s1 = left->start, n1 = left->len, n2 = right->len;
+    left->len = n1 + n2;
+
+    // Skip the head of the left run and the tail of the right run that are already in place
+    int k = GallopUpper(a + s1, n1, a[s1 + n1]);
+    s1 += k;
+    n1 -= k;
+    if (n1 == 0) return;
+    n2 = GallopLower(a + s1 + n1, n2, a[s1 + n1 - 1]);
+    if (n2 == 0) return;
+
+    // While galloping does not pay, merge similar runs a vector at a time;
+    // the right run already ends the output (out == b - na, simd_sort.h)
+    if (ms->minGallop >= MIN_GALLOP && n1 <= VECTOR_MERGE_RATIO * n2 && n2 <= VECTOR_MERGE_RATIO * n1 &&
+        n1 <= ms->capacity) {
+        memcpy(ms->tmp, a + s1, n1 * sizeof(int));
+        MergeSortedArrays(ms->tmp, n1, a + s1 + n1, n2, a + s1);
+    } else if (n1 <= n2) {
+        MergeLo(a, s1, n1, n2, ms);
+    } else {
+        MergeHi(a, s1, n1, n2, ms);
+    }
+}
+
+void PowerSort(int *a, int n) {
+    if (n < 2) return;
+
+    MergeState ms;
+    ms.capacity = n / 2 + 1;
+    ms.tmp = (int *)malloc(ms.capacity * sizeof(int));
+    if (!ms.tmp) {
+        HeapSort(a, n);
+        return;
+    }
+    ms.minGallop = MIN_GALLOP;
+
+    PowerRun stack[POWER_SORT_MAX_STACK];
+    int top = 0;
+    int minRun = MinRunLength(n);
+
+    for (int lo = 0; lo < n;) {
+        int len = CountRun(a, lo, n);
+        if (len < minRun) {
+            int force = n - lo < minRun ? n - lo : minRun;
+            ExtendRun(a + lo, len, force);
+            len = force;
+        }
+
+        if (top > 0) {
+            int power = NodePower(stack[top - 1].start, stack[top - 1].len, len, n);
+            while (top > 1 && stack[top - 2].power > power) {
+                MergeRuns(a, &stack[top - 2], &stack[top - 1], &ms);
+                top--;
+            }
+            stack[top - 1].power = power;
+        }
+        stack[top].start = lo;
+        stack[top].len = len;
+        stack[top].power = 0;
+        top++;
+        lo += len;
+    }
+
+    while (top > 1) {
+        MergeRuns(a, &stack[top - 2], &stack[top - 1], &ms);
+        top--;
+    }
+    free(ms.tmp);
+}
@@ -1,21 +1,82 @@
 #include "include/sort/quick_sort.h"
+#include "include/sort/heap_sort.h"
+#include "include/sort/simd_sort.h"
+#include "include/sort/sort_stats.h"
+
+#define QUICK_SORT_CUTOFF SIMD_BLOCK_MAX
+#define NINTHER_THRESHOLD 128
 
 int Partition(int *a, int low, int high) {
     int pivot = a[low];
     while (low < high) {
-        while (low < high && a[high] >= pivot) high--;
-        a[low] = a[high];
-        while (low < high && a[low] <= pivot) low++;
-        a[high] = a[low];
+        while (low < high && SORT_CMP(a[high] > pivot)) high--;
+        if (low < high) {
+            a[low++] = a[high];
+            SORT_MOVES(1);
+        }
+        while (low < high && SORT_CMP(a[low] < pivot)) low++;
+        if (low < high) {
+            a[high--] = a[low];
+            SORT_MOVES(1);
+        }
     }
     a[low] = pivot;
+    SORT_MOVES(1);
     return low;
 }
 
+static int MedianOfThree(int *a, int i, int j, int k) {
+    if (SORT_CMP(a[i] < a[j])) {
+        if (SORT_CMP(a[j] < a[k])) return j;
+        return SORT_CMP(a[i] < a[k]) ? k : i;
+    }
+    if (SORT_CMP(a[i] < a[k])) return i;
+    return SORT_CMP(a[j] < a[k]) ? k : j;
+}
+
+static int ChoosePivot(int *a, int low, int high) {
+    int n = high - low + 1;
+    int mid = low + n / 2;
+    if (n > NINTHER_THRESHOLD) {
+        int s = n / 8;
+        int m1 = MedianOfThree(a, low, low + s, low + 2 * s);
+        int m2 = MedianOfThree(a, mid - s, mid, mid + s);
+        int m3 = MedianOfThree(a, high - 2 * s, high - s, high);
+        return MedianOfThree(a, m1, m2, m3);
+    }
+    return MedianOfThree(a, low, mid, high);
+}
+
+static void IntroSort(int *a, int low, int high, int depthLimit) {
+    while (high - low + 1 > QUICK_SORT_CUTOFF) {
+        if (depthLimit == 0) {
+            HeapSort(a + low, high - low + 1);
+            return;
+        }
+        depthLimit--;
+        int p = ChoosePivot(a, low, high);
+        int temp = a[low];
+        a[low] = a[p];
+        a[p] = temp;
+        SORT_MOVES(2);
+        int pivotpos = Partition(a, low, high);
+        if (pivotpos - low < high - pivotpos) {
+            IntroSort(a, low, pivotpos - 1, depthLimit);
+            low = pivotpos + 1;
+        } else {
+            IntroSort(a, pivotpos + 1, high, depthLimit);
+            high = pivotpos - 1;
+        }
+    }
+    if (low < high) {
+        SortingNetwork(a + low, high - low + 1);
+    }
+}
+
 void QuickSort(int *a, int low, int high) {
     if (low < high) {
-        int pivotpos = Partition(a, low, high);
-        QuickSort(a, low, pivotpos - 1);
-        QuickSort(a, pivotpos + 1, high);
+        int depthLimit = 0;
+        for (int n = high - low + 1; n > 1; n >>= 1) depthLimit += 2;
+        IntroSort(a, low, high, depthLimit);
     }
 }
@@ -1,39 +1,247 @@
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
+#include <pthread.h>
 #include "include/sort/radix_sort.h"
+#include "include/sort/sort_stats.h"
 
-int GetMax(int *a, int n) {
-    int max = a[0];
-    for (int i = 1; i < n; i++) {
-        if (a[i] > max) {
-            max = a[i];
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES 4
+
+// Flipping the sign bit makes unsigned byte order match signed int order
+static unsigned int RadixKey(int x) {
+    return (unsigned int)x ^ 0x80000000u;
+}
+
+void RadixSort(int *a, int n) {
+    if (n < 2) return;
+
+    // One read pass builds the histograms of all four bytes
+    int count[RADIX_PASSES][RADIX_BUCKETS];
+    memset(count, 0, sizeof(count));
+    for (int i = 0; i < n; i++) {
+        unsigned int key = RadixKey(a[i]);
+        for (int p = 0; p < RADIX_PASSES; p++) {
+            count[p][(key >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
         }
     }
-    return max;
+
+    int *b = (int *)malloc(n * sizeof(int));
+    int *src = a, *dst = b;
+    unsigned int first = RadixKey(a[0]);
+    for (int p = 0; p < RADIX_PASSES; p++) {
+        int shift = p * RADIX_BITS;
+        // Every key has the same byte here, so the pass would not move anything
+        if (count[p][(first >> shift) & (RADIX_BUCKETS - 1)] == n) continue;
+
+        int offset[RADIX_BUCKETS];
+        int sum = 0;
+        for (int d = 0; d < RADIX_BUCKETS; d++) {
+            offset[d] = sum;
+            sum += count[p][d];
+        }
+        for (int i = 0; i < n; i++) {
+            dst[offset[(RadixKey(src[i]) >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+        SORT_MOVES(n);
+        int *temp = src;
+        src = dst;
+        dst = temp;
+    }
+    if (src != a) {
+        memcpy(a, src, n * sizeof(int));
+        SORT_MOVES(n);
+    }
+    free(b);
 }
 
-void CountSort(int *a, int n, int exp) {
-    int *output = (int *)malloc(n * sizeof(int));
-    int count[10] = {0};
-    for (int i = 0; i < n; i++) {
-        count[(a[i] / exp) % 10]++;
+/*
+ * American flag sort
+ *
+ * In-place MSD radix sort on 64-bit keys, one byte per level starting at
+ * the most significant byte. Each level counts the bucket sizes and then
+ * permutes elements into their buckets by following swap cycles, so no
+ * second array is needed. Buckets of at most MSD_RADIX_CUTOFF elements are
+ * finished with insertion sort. The same code is instantiated for bare keys
+ * and for key/value pairs.
+ */
+
+#define MSD_RADIX_CUTOFF 32
+#define MSD_PARALLEL_MIN 65536
+#define MSD_BYTE(k, shift) ((unsigned int)((k) >> (shift)) & (RADIX_BUCKETS - 1))
+#define PLAIN_KEY(x) (x)
+#define PAIR_KEY(x) ((x).key)
+
+#define DEFINE_FLAG_SORT(Prefix, Type, KEY)                                    \
+static void Prefix##InsertSort(Type *a, size_t n) {                            \
+    for (size_t i = 1; i < n; i++) {                                           \
+        if (KEY(a[i]) < KEY(a[i - 1])) {                                       \
+            Type temp = a[i];                                                  \
+            size_t j;                                                          \
+            for (j = i; j > 0 && KEY(temp) < KEY(a[j - 1]); j--) {             \
+                a[j] = a[j - 1];                                               \
+            }                                                                  \
+            a[j] = temp;                                                       \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Prefix##Histogram(const Type *a, size_t n, int shift,              \
+                              size_t *count) {                                 \
+    memset(count, 0, RADIX_BUCKETS * sizeof(size_t));                          \
+    for (size_t i = 0; i < n; i++) {                                           \
+        count[MSD_BYTE(KEY(a[i]), shift)]++;                                   \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Prefix##Permute(Type *a, int shift, const size_t *count,           \
+                            size_t *start) {                                   \
+    size_t head[RADIX_BUCKETS], tail[RADIX_BUCKETS];                           \
+    size_t sum = 0;                                                            \
+    for (int d = 0; d < RADIX_BUCKETS; d++) {                                  \
+        start[d] = head[d] = sum;                                              \
+        sum += count[d];                                                       \
+        tail[d] = sum;                                                         \
+    }                                                                          \
+    for (int d = 0; d < RADIX_BUCKETS; d++) {                                  \
+        while (head[d] < tail[d]) {                                            \
+            Type v = a[head[d]];                                               \
+            unsigned int b = MSD_BYTE(KEY(v), shift);                          \
+            while (b != (unsigned int)d) {                                     \
+                Type temp = a[head[b]];                                        \
+                a[head[b]++] = v;                                              \
+                v = temp;                                                      \
+                b = MSD_BYTE(KEY(v), shift);                                   \
+            }                                                                  \
+            a[head[d]++] = v;                                                  \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Prefix##Sort(Type *a, size_t n, int shift) {                       \
+    size_t count[RADIX_BUCKETS], start[RADIX_BUCKETS];                         \
+    if (n <= MSD_RADIX_CUTOFF) {                                               \
+        Prefix##InsertSort(a, n);                                              \
+        return;                                                                \
+    }                                                                          \
+    for (;;) {                                                                 \
+        Prefix##Histogram(a, n, shift, count);                                 \
+        if (count[MSD_BYTE(KEY(a[0]), shift)] < n) break;                      \
+        if (shift == 0) return;                                                \
+        shift -= RADIX_BITS;                                                   \
+    }                                                                          \
+    Prefix##Permute(a, shift, count, start);                                   \
+    if (shift == 0) return;                                                    \
+    for (int d = 0; d < RADIX_BUCKETS; d++) {                                  \
+        if (count[d] > 1) {                                                    \
+            Prefix##Sort(a + start[d], count[d], shift - RADIX_BITS);          \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void Prefix##SortBucket(void *a, size_t n, int shift) {                 \
+    Prefix##Sort((Type *)a, n, shift);                                         \
+}
+
+DEFINE_FLAG_SORT(Key, uint64_t, PLAIN_KEY)
+DEFINE_FLAG_SORT(Pair, KeyValue64, PAIR_KEY)
+
+// Buckets of the first distinguishing byte, handed out to threads largest first
+typedef struct {
+    pthread_mutex_t lock;
+    char *base;
+    size_t size;
+    int shift;
+    size_t count[RADIX_BUCKETS];
+    size_t start[RADIX_BUCKETS];
+    int order[RADIX_BUCKETS];
+    int next;
+    void (*sortBucket)(void *a, size_t n, int shift);
+} FlagSortJob;
+
+static void *FlagSortWorker(void *arg) {
+    FlagSortJob *job = (FlagSortJob *)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int index = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (index >= RADIX_BUCKETS) break;
+
+        int d = job->order[index];
+        if (job->count[d] > 1) {
+            job->sortBucket(job->base + job->start[d] * job->size, job->count[d],
+                            job->shift - RADIX_BITS);
+        }
     }
-    for (int i = 1; i < 10; i++) {
-        count[i] += count[i - 1];
+    return NULL;
+}
+
+static void RunFlagSortJob(FlagSortJob *job, int threads) {
+    for (int i = 0; i < RADIX_BUCKETS; i++) {
+        int d = i, j;
+        for (j = i; j > 0 && job->count[job->order[j - 1]] < job->count[d]; j--) {
+            job->order[j] = job->order[j - 1];
+        }
+        job->order[j] = d;
     }
-    for (int i = n - 1; i >= 0; i--) {
-        output[count[(a[i] / exp) % 10] - 1] = a[i];
-        count[(a[i] / exp) % 10]--;
+    job->next = 0;
+    pthread_mutex_init(&job->lock, NULL);
+
+    pthread_t *workers = (pthread_t *)malloc((threads - 1) * sizeof(pthread_t));
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_create(&workers[i], NULL, FlagSortWorker, job);
     }
-    for (int i = 0; i < n; i++) {
-        a[i] = output[i];
+    FlagSortWorker(job);
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_join(workers[i], NULL);
     }
-    free(output);
+
+    free(workers);
+    pthread_mutex_destroy(&job->lock);
 }
 
-void RadixSort(int *a, int n) {
-    int max = GetMax(a, n);
-    for (int exp = 1; max / exp > 0; exp *= 10) {
-        CountSort(a, n, exp);
+void AmericanFlagSort64(uint64_t *a, size_t n, int threads) {
+    if (threads <= 1 || n < MSD_PARALLEL_MIN) {
+        KeySort(a, n, 64 - RADIX_BITS);
+        return;
     }
+
+    FlagSortJob job;
+    job.shift = 64 - RADIX_BITS;
+    for (;;) {
+        KeyHistogram(a, n, job.shift, job.count);
+        if (job.count[MSD_BYTE(a[0], job.shift)] < n) break;
+        if (job.shift == 0) return;
+        job.shift -= RADIX_BITS;
+    }
+    KeyPermute(a, job.shift, job.count, job.start);
+    if (job.shift == 0) return;
+
+    job.base = (char *)a;
+    job.size = sizeof(uint64_t);
+    job.sortBucket = KeySortBucket;
+    RunFlagSortJob(&job, threads);
+}
+
+void AmericanFlagSortPairs(KeyValue64 *a, size_t n, int threads) {
+    if (threads <= 1 || n < MSD_PARALLEL_MIN) {
+        PairSort(a, n, 64 - RADIX_BITS);
+        return;
+    }
+
+    FlagSortJob job;
+    job.shift = 64 - RADIX_BITS;
+    for (;;) {
+        PairHistogram(a, n, job.shift, job.count);
+        if (job.count[MSD_BYTE(a[0].key, job.shift)] < n) break;
+        if (job.shift == 0) return;
+        job.shift -= RADIX_BITS;
+    }
+    PairPermute(a, job.shift, job.count, job.start);
+    if (job.shift == 0) return;
+
+    job.base = (char *)a;
+    job.size = sizeof(KeyValue64);
+    job.sortBucket = PairSortBucket;
+    RunFlagSortJob(&job, threads);
 }
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "include/sort/run_codec.h"
+
+/*
+ * Run block codec
+ *
+ * Sorted runs are stored in blocks of up to RUN_CODEC_BLOCK values: the
+ * header holds the count, a bit width and the first value, then the
+ * deltas between neighbours follow bit-packed at that one width in 32-bit
+ * words (frame of reference). Sorted input has small non-negative deltas,
+ * so random 32-bit keys in a run of a million take about 14 bits each.
+ * Deltas are taken modulo 2^32, so any input round-trips; unsorted blocks
+ * just fall back to 32 bits. A fixed width per block keeps the decoder a
+ * branch-free shift-and-mask loop followed by a prefix sum.
+ */
+
+// Header: count (2 bytes), bit width, unused, first value (4 bytes)
+int RunCodecEncodeBlock(const int *values, int n, unsigned char *out) {
+    unsigned int deltas[RUN_CODEC_BLOCK];
+    unsigned int words[RUN_CODEC_BLOCK];
+    unsigned int all = 0;
+    for (int i = 1; i < n; i++) {
+        deltas[i - 1] = (unsigned int)values[i] - (unsigned int)values[i - 1];
+        all |= deltas[i - 1];
+    }
+    int bits = 0;
+    while (bits < 32 && (all >> bits) != 0) {
+        bits++;
+    }
+
+    unsigned long long acc = 0;
+    int filled = 0, w = 0;
+    for (int i = 0; i < n - 1 && bits > 0; i++) {
+        acc |= (unsigned long long)deltas[i] << filled;
+        filled += bits;
+        if (filled >= 32) {
+            words[w++] = (unsigned int)acc;
+            acc >>= 32;
+            filled -= 32;
+        }
+    }
+    if (filled > 0) {
+        words[w++] = (unsigned int)acc;
+    }
+
+    out[0] = (unsigned char)(n & 0xFF);
+    out[1] = (unsigned char)(n >> 8);
+    out[2] = (unsigned char)bits;
+    out[3] = 0;
+    memcpy(out + 4, &values[0], sizeof(int));
+    memcpy(out + RUN_CODEC_HEADER, words, w * sizeof(unsigned int));
+    return RUN_CODEC_HEADER + w * (int)sizeof(unsigned int);
+}
+
+// Run files come from disk, so a header is checked before it sizes a read
+static int ValidHeader(int n, int bits) {
+    return n >= 1 && n <= RUN_CODEC_BLOCK && bits <= 32;
+}
+
+int RunCodecBlockBytes(const unsigned char *header) {
+    int n = header[0] | header[1] << 8;
+    int bits = header[2];
+    if (!ValidHeader(n, bits)) {
+        return -1;
+    }
+    return RUN_CODEC_HEADER + ((n - 1) * bits + 31) / 32 * (int)sizeof(unsigned int);
+}
+
+int RunCodecDecodeBlock(const unsigned char *in, int *values) {
+    unsigned int words[RUN_CODEC_BLOCK];
+    int n = in[0] | in[1] << 8;
+    int bits = in[2];
+    if (!ValidHeader(n, bits)) {
+        return 0;
+    }
+    unsigned int mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    int first;
+    memcpy(&first, in + 4, sizeof(int));
+    memcpy(words, in + RUN_CODEC_HEADER, ((n - 1) * bits + 31) / 32 * sizeof(unsigned int));
+
+    unsigned long long acc = 0;
+    int filled = 0, w = 0;
+    unsigned int value = (unsigned int)first;
+    values[0] = first;
+    for (int i = 1; i < n; i++) {
+        if (filled < bits) {
+            acc |= (unsigned long long)words[w++] << filled;
+            filled += 32;
+        }
+        value += (unsigned int)acc & mask;
+        acc >>= bits;
+        filled -= bits;
+        values[i] = (int)value;
+    }
+    return n;
+}
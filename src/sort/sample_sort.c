@@ -0,0 +1,261 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "include/sort/sample_sort.h"
+#include "include/sort/quick_sort.h"
+#include "include/sort/simd_sort.h"
+#include "include/sort/sort_ex.h"
+
+/*
+ * Parallel sample sort
+ *
+ * A random sample is sorted and every SAMPLE_OVERSAMPLING-th element
+ * becomes a splitter. The splitters are stored as an implicit search tree
+ * (root at 1, children of j at 2j and 2j+1), so classifying a key is
+ * log2(buckets) branch-free steps j = 2j + (x > tree[j]); with AVX2 eight
+ * keys descend the tree at once through gathers. A key equal to the
+ * upper splitter of its bucket goes to an equality bucket beside it,
+ * which needs no sorting, so heavy duplicates do not pile up in one
+ * bucket that a single thread has to sort. Each thread classifies its
+ * slice into a one-byte-per-element oracle, the per-thread counts give
+ * every thread its own write window in each bucket, the elements are
+ * scattered into one scratch array, and the buckets are sorted with
+ * QuickSort and copied back in parallel.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SAMPLE_SORT_X86 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#define SAMPLE_SORT_MIN 65536
+#define SAMPLE_OVERSAMPLING 32
+#define SAMPLE_BUCKETS_PER_THREAD 8
+#define SAMPLE_MAX_BUCKETS 128          // twice as many with equality buckets, one oracle byte
+
+#define INT_LESS(x, y) ((x) < (y))
+SORT_EX_DEFINE(IntroSortLarge, int, INT_LESS)
+
+// QuickSort takes int bounds; larger ranges go to the size_t introsort
+static void SortRange(int *a, size_t n) {
+    if (n <= 1) return;
+    if (n <= (size_t)INT_MAX) {
+        QuickSort(a, 0, (int)(n - 1));
+    } else {
+        IntroSortLarge(a, n);
+    }
+}
+
+typedef struct {
+    int *a, *b;
+    unsigned char *oracle;
+    size_t n;
+    int threads;
+    int buckets;                    // splitter buckets; bucket j is 2j, its equality bucket 2j + 1
+    int logBuckets;
+    int tree[SAMPLE_MAX_BUCKETS];
+    int upper[SAMPLE_MAX_BUCKETS];  // upper splitter of each bucket; the last repeats the one below it
+    size_t *count;                  // threads x 2 buckets, then write offsets
+    size_t start[2 * SAMPLE_MAX_BUCKETS + 1];
+    int nextBucket;
+    pthread_mutex_t lock;
+} SampleSortJob;
+
+typedef struct {
+    SampleSortJob *job;
+    int id;
+} SampleSortWorker;
+
+static int SampleBuckets(int threads) {
+    int buckets = 2;
+    while (buckets < threads * SAMPLE_BUCKETS_PER_THREAD && buckets < SAMPLE_MAX_BUCKETS) {
+        buckets *= 2;
+    }
+    return buckets;
+}
+
+size_t SampleSortMemory(size_t n, int threads) {
+    if (threads <= 1 || n < SAMPLE_SORT_MIN) return 0;
+    int buckets = SampleBuckets(threads);
+    return n * sizeof(int) + n + (size_t)threads * 2 * buckets * sizeof(size_t)
+           + (size_t)buckets * SAMPLE_OVERSAMPLING * sizeof(int);
+}
+
+static void BuildSplitterTree(SampleSortJob *job, int *a, size_t n) {
+    int k = job->buckets;
+    int sampleSize = k * SAMPLE_OVERSAMPLING;
+    int *sample = (int *)malloc(sampleSize * sizeof(int));
+    unsigned long long state = 88172645463325252ull ^ n;
+    for (int i = 0; i < sampleSize; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sample[i] = a[state % n];
+    }
+    QuickSort(sample, 0, sampleSize - 1);
+
+    // Node j on level l is the (2p+1)-th splitter of its level, p = j - 2^l
+    for (int level = 0; level < job->logBuckets; level++) {
+        for (int p = 0; p < (1 << level); p++) {
+            int splitter = (2 * p + 1) * (k >> (level + 1)) - 1;
+            job->tree[(1 << level) + p] = sample[(splitter + 1) * SAMPLE_OVERSAMPLING - 1];
+        }
+    }
+    // Keys of the last bucket are all above the splitter below it
+    for (int j = 0; j < k - 1; j++) {
+        job->upper[j] = sample[(j + 1) * SAMPLE_OVERSAMPLING - 1];
+    }
+    job->upper[k - 1] = job->upper[k - 2];
+    free(sample);
+}
+
+static void ClassifyScalar(const SampleSortJob *job, size_t low, size_t high, size_t *count) {
+    for (size_t i = low; i < high; i++) {
+        int x = job->a[i];
+        int j = 1;
+        for (int l = 0; l < job->logBuckets; l++) {
+            j = 2 * j + (x > job->tree[j]);
+        }
+        j -= job->buckets;
+        int bucket = 2 * j + (x == job->upper[j]);
+        job->oracle[i] = (unsigned char)bucket;
+        count[bucket]++;
+    }
+}
+
+#ifdef SAMPLE_SORT_X86
+AVX2_TARGET static void ClassifyAvx2(const SampleSortJob *job, size_t low, size_t high, size_t *count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i buckets = _mm256_set1_epi32(job->buckets);
+    int bucket[8];
+    size_t i = low;
+    for (; i + 8 <= high; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(job->a + i));
+        __m256i j = one;
+        for (int l = 0; l < job->logBuckets; l++) {
+            __m256i s = _mm256_i32gather_epi32(job->tree, j, 4);
+            j = _mm256_sub_epi32(_mm256_add_epi32(j, j), _mm256_cmpgt_epi32(x, s));
+        }
+        j = _mm256_sub_epi32(j, buckets);
+        __m256i equal = _mm256_cmpeq_epi32(x, _mm256_i32gather_epi32(job->upper, j, 4));
+        _mm256_storeu_si256((__m256i *)bucket, _mm256_sub_epi32(_mm256_add_epi32(j, j), equal));
+        for (int t = 0; t < 8; t++) {
+            job->oracle[i + t] = (unsigned char)bucket[t];
+            count[bucket[t]]++;
+        }
+    }
+    ClassifyScalar(job, i, high, count);
+}
+#endif
+
+static void *ClassifyWorker(void *arg) {
+    SampleSortWorker *w = (SampleSortWorker *)arg;
+    SampleSortJob *job = w->job;
+    size_t low = job->n * w->id / job->threads;
+    size_t high = job->n * (w->id + 1) / job->threads;
+    size_t *count = job->count + (size_t)w->id * 2 * job->buckets;
+#ifdef SAMPLE_SORT_X86
+    if (SimdSortAvailable()) {
+        ClassifyAvx2(job, low, high, count);
+        return NULL;
+    }
+#endif
+    ClassifyScalar(job, low, high, count);
+    return NULL;
+}
+
+static void *ScatterWorker(void *arg) {
+    SampleSortWorker *w = (SampleSortWorker *)arg;
+    SampleSortJob *job = w->job;
+    size_t low = job->n * w->id / job->threads;
+    size_t high = job->n * (w->id + 1) / job->threads;
+    size_t *offset = job->count + (size_t)w->id * 2 * job->buckets;
+    for (size_t i = low; i < high; i++) {
+        job->b[offset[job->oracle[i]]++] = job->a[i];
+    }
+    return NULL;
+}
+
+static void *BucketWorker(void *arg) {
+    SampleSortJob *job = ((SampleSortWorker *)arg)->job;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int bucket = job->nextBucket++;
+        pthread_mutex_unlock(&job->lock);
+        if (bucket >= 2 * job->buckets) break;
+
+        size_t low = job->start[bucket];
+        size_t size = job->start[bucket + 1] - low;
+        if (bucket % 2 == 0) {
+            SortRange(job->b + low, size);
+        }
+        memcpy(job->a + low, job->b + low, size * sizeof(int));
+    }
+    return NULL;
+}
+
+static void RunWorkers(SampleSortJob *job, SampleSortWorker *workers, pthread_t *tid,
+                       void *(*fn)(void *)) {
+    for (int t = 1; t < job->threads; t++) {
+        pthread_create(&tid[t], NULL, fn, &workers[t]);
+    }
+    fn(&workers[0]);
+    for (int t = 1; t < job->threads; t++) {
+        pthread_join(tid[t], NULL);
+    }
+}
+
+void SampleSort(int *a, size_t n, int threads) {
+    if (threads <= 1 || n < SAMPLE_SORT_MIN) {
+        SortRange(a, n);
+        return;
+    }
+
+    SampleSortJob job;
+    job.a = a;
+    job.n = n;
+    job.threads = threads;
+    job.buckets = SampleBuckets(threads);
+    job.logBuckets = 0;
+    while ((1 << job.logBuckets) < job.buckets) job.logBuckets++;
+    job.b = (int *)malloc(n * sizeof(int));
+    job.oracle = (unsigned char *)malloc(n);
+    job.count = (size_t *)calloc((size_t)threads * 2 * job.buckets, sizeof(size_t));
+    job.nextBucket = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    SampleSortWorker *workers = (SampleSortWorker *)malloc(threads * sizeof(SampleSortWorker));
+    pthread_t *tid = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    for (int t = 0; t < threads; t++) {
+        workers[t].job = &job;
+        workers[t].id = t;
+    }
+
+    BuildSplitterTree(&job, a, n);
+    RunWorkers(&job, workers, tid, ClassifyWorker);
+
+    // Bucket-major prefix sum turns the counts into per-thread write offsets
+    int buckets = 2 * job.buckets;
+    size_t sum = 0;
+    for (int bucket = 0; bucket < buckets; bucket++) {
+        job.start[bucket] = sum;
+        for (int t = 0; t < threads; t++) {
+            size_t c = job.count[(size_t)t * buckets + bucket];
+            job.count[(size_t)t * buckets + bucket] = sum;
+            sum += c;
+        }
+    }
+    job.start[buckets] = sum;
+
+    RunWorkers(&job, workers, tid, ScatterWorker);
+    RunWorkers(&job, workers, tid, BucketWorker);
+
+    pthread_mutex_destroy(&job.lock);
+    free(tid);
+    free(workers);
+    free(job.count);
+    free(job.oracle);
+    free(job.b);
+}
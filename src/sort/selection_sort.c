@@ -1,10 +1,11 @@
 #include "include/sort/selection_sort.h"
+#include "include/sort/sort_stats.h"
 
 void SelectionSort(int *a, int n) {
     for (int i = 0; i < n - 1; i++) {
         int min = i;
         for (int j = i + 1; j < n; j++) {
-            if (a[j] < a[min]) {
+            if (SORT_CMP(a[j] < a[min])) {
                 min = j;
             }
         }
@@ -12,6 +13,7 @@ void SelectionSort(int *a, int n) {
             int temp = a[i];
             a[i] = a[min];
             a[min] = temp;
+            SORT_MOVES(2);
         }
     }
 }
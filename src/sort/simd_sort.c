@@ -0,0 +1,201 @@
+#include <limits.h>
+#include <string.h>
+#include "include/sort/simd_sort.h"
+#include "include/sort/insert_sort.h"
+#include "include/sort/sort_stats.h"
+
+/*
+ * SIMD sort kernels
+ *
+ * Eight ints fit in one AVX2 register. A compare-exchange layer permutes
+ * the register to line every lane up with its partner, takes min and max
+ * and blends them back, so a bitonic network on 8 elements is 6 layers.
+ * 16 and 32 element blocks are sorted as 8-blocks and merged with bitonic
+ * merges. The AVX2 code is compiled with a target attribute and picked at
+ * run time through CPUID, so the rest of the tree needs no extra flags.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SORT_X86 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+static int simdEnabled = 1;
+
+int SimdSortAvailable(void) {
+#if defined(SORT_STATS)
+    return 0;
+#elif defined(SIMD_SORT_X86)
+    return simdEnabled && __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+void SimdSortEnable(int enable) {
+    simdEnabled = enable;
+}
+
+#ifdef SIMD_SORT_X86
+
+// Compare-exchange every lane with lane idx[i]; lanes set in mask keep the max
+#define EXCHANGE(v, idx, mask) do {                                            \
+    __m256i p_ = _mm256_permutevar8x32_epi32(v, idx);                          \
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p_), _mm256_max_epi32(v, p_),   \
+                           mask);                                              \
+} while (0)
+
+#define SWAP1 _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6)
+#define SWAP2 _mm256_setr_epi32(2, 3, 0, 1, 6, 7, 4, 5)
+#define SWAP4 _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3)
+#define REVERSE _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)
+
+AVX2_TARGET static __m256i Sort8(__m256i v) {
+    EXCHANGE(v, SWAP1, 0x66);
+    EXCHANGE(v, SWAP2, 0x3C);
+    EXCHANGE(v, SWAP1, 0x5A);
+    EXCHANGE(v, SWAP4, 0xF0);
+    EXCHANGE(v, SWAP2, 0xCC);
+    EXCHANGE(v, SWAP1, 0xAA);
+    return v;
+}
+
+// Sort a bitonic register
+AVX2_TARGET static __m256i BitonicClean8(__m256i v) {
+    EXCHANGE(v, SWAP4, 0xF0);
+    EXCHANGE(v, SWAP2, 0xCC);
+    EXCHANGE(v, SWAP1, 0xAA);
+    return v;
+}
+
+// Merge two sorted registers: *lo gets the 8 smallest, *hi the 8 largest
+AVX2_TARGET static void Merge8(__m256i *lo, __m256i *hi) {
+    __m256i r = _mm256_permutevar8x32_epi32(*hi, REVERSE);
+    __m256i l = _mm256_min_epi32(*lo, r);
+    __m256i h = _mm256_max_epi32(*lo, r);
+    *lo = BitonicClean8(l);
+    *hi = BitonicClean8(h);
+}
+
+// Merge two sorted 16-element pairs (v[0], v[1]) and (v[2], v[3])
+AVX2_TARGET static void Merge16(__m256i *v) {
+    __m256i r2 = _mm256_permutevar8x32_epi32(v[3], REVERSE);
+    __m256i r3 = _mm256_permutevar8x32_epi32(v[2], REVERSE);
+    __m256i l0 = _mm256_min_epi32(v[0], r2), h0 = _mm256_max_epi32(v[0], r2);
+    __m256i l1 = _mm256_min_epi32(v[1], r3), h1 = _mm256_max_epi32(v[1], r3);
+    v[0] = BitonicClean8(_mm256_min_epi32(l0, l1));
+    v[1] = BitonicClean8(_mm256_max_epi32(l0, l1));
+    v[2] = BitonicClean8(_mm256_min_epi32(h0, h1));
+    v[3] = BitonicClean8(_mm256_max_epi32(h0, h1));
+}
+
+AVX2_TARGET static void SortingNetworkAvx2(int *a, int n) {
+    int buf[SIMD_BLOCK_MAX];
+    int blocks = n <= 8 ? 1 : (n <= 16 ? 2 : 4);
+    memcpy(buf, a, n * sizeof(int));
+    for (int i = n; i < blocks * 8; i++) {
+        buf[i] = INT_MAX;
+    }
+
+    __m256i v[4];
+    for (int i = 0; i < blocks; i++) {
+        v[i] = Sort8(_mm256_loadu_si256((const __m256i *)(buf + 8 * i)));
+    }
+    if (blocks >= 2) Merge8(&v[0], &v[1]);
+    if (blocks == 4) {
+        Merge8(&v[2], &v[3]);
+        Merge16(v);
+    }
+    for (int i = 0; i < blocks; i++) {
+        _mm256_storeu_si256((__m256i *)(buf + 8 * i), v[i]);
+    }
+    memcpy(a, buf, n * sizeof(int));
+}
+
+/*
+ * Vectorized merge: keep the 8 largest elements seen so far in hi, load
+ * the next 8 from whichever input has the smaller head, merge the two
+ * registers and emit the lower half. The remainder is merged scalar.
+ */
+// With hi holding 8 values, out[k..k+8) ends 8 below the inputs consumed,
+// so each store lands below the block of b it was just loaded from
+AVX2_TARGET static void MergeSortedArraysAvx2(const int *a, int na, const int *b, int nb, int *out) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)a);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)b);
+    int i = 8, j = 8, k = 0;
+    Merge8(&lo, &hi);
+    _mm256_storeu_si256((__m256i *)out, lo);
+    k += 8;
+
+    for (;;) {
+        int takeA;
+        if (i < na && j < nb) {
+            takeA = a[i] <= b[j];
+        } else if (i < na || j < nb) {
+            takeA = i < na;
+        } else {
+            break;
+        }
+        if (takeA ? i + 8 > na : j + 8 > nb) break;
+        if (takeA) {
+            lo = _mm256_loadu_si256((const __m256i *)(a + i));
+            i += 8;
+        } else {
+            lo = _mm256_loadu_si256((const __m256i *)(b + j));
+            j += 8;
+        }
+        Merge8(&lo, &hi);
+        _mm256_storeu_si256((__m256i *)(out + k), lo);
+        k += 8;
+    }
+
+    int pending[8];
+    int p = 0;
+    _mm256_storeu_si256((__m256i *)pending, hi);
+    while (p < 8 || i < na || j < nb) {
+        if (p < 8 && (i >= na || pending[p] <= a[i]) && (j >= nb || pending[p] <= b[j])) {
+            out[k++] = pending[p++];
+        } else if (i < na && (j >= nb || a[i] <= b[j])) {
+            out[k++] = a[i++];
+        } else {
+            out[k++] = b[j++];
+        }
+    }
+}
+
+#endif
+
+void SortingNetwork(int *a, int n) {
+#ifdef SIMD_SORT_X86
+    if (n > 1 && n <= SIMD_BLOCK_MAX && SimdSortAvailable()) {
+        SortingNetworkAvx2(a, n);
+        return;
+    }
+#endif
+    InsertSort(a, n);
+}
+
+void MergeSortedArrays(const int *a, int na, const int *b, int nb, int *out) {
+#ifdef SIMD_SORT_X86
+    if (na >= 8 && nb >= 8 && SimdSortAvailable()) {
+        MergeSortedArraysAvx2(a, na, b, nb, out);
+        return;
+    }
+#endif
+    int i = 0, j = 0, k = 0;
+    SORT_MOVES(na + nb);
+    while (i < na && j < nb) {
+        if (SORT_CMP(a[i] <= b[j])) {
+            out[k++] = a[i++];
+        } else {
+            out[k++] = b[j++];
+        }
+    }
+    while (i < na) {
+        out[k++] = a[i++];
+    }
+    while (j < nb) {
+        out[k++] = b[j++];
+    }
+}
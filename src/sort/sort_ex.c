@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/sort/sort_ex.h"
+
+/*
+ * Generic record sorts
+ *
+ * Same algorithms as the int sorts, but records are moved in place with
+ * CopyRecord. The 4-, 8- and 16-byte cases use constant-size memcpy, which
+ * the compiler turns into single loads and stores.
+ */
+
+typedef struct {
+    char *base;
+    size_t size;
+    SortCompare cmp;
+    char *temp;             // one record of scratch
+    char *pivot;            // one record of scratch
+    char *buffer;           // n records of scratch, merge sort only
+} SortContext;
+
+#define RECORD(ctx, i) ((ctx)->base + (i) * (ctx)->size)
+
+static void CopyRecord(char *dst, const char *src, size_t size) {
+    switch (size) {
+        case 4:  memcpy(dst, src, 4); break;
+        case 8:  memcpy(dst, src, 8); break;
+        case 16: memcpy(dst, src, 16); break;
+        default: memcpy(dst, src, size); break;
+    }
+}
+
+static void SwapRecord(SortContext *ctx, size_t i, size_t j) {
+    CopyRecord(ctx->temp, RECORD(ctx, i), ctx->size);
+    CopyRecord(RECORD(ctx, i), RECORD(ctx, j), ctx->size);
+    CopyRecord(RECORD(ctx, j), ctx->temp, ctx->size);
+}
+
+static int Less(SortContext *ctx, const char *x, const char *y) {
+    return ctx->cmp(x, y) < 0;
+}
+
+static void InsertSortEx(SortContext *ctx, size_t low, size_t n) {
+    for (size_t i = low + 1; i < low + n; i++) {
+        if (Less(ctx, RECORD(ctx, i), RECORD(ctx, i - 1))) {
+            CopyRecord(ctx->temp, RECORD(ctx, i), ctx->size);
+            size_t j = i;
+            do {
+                CopyRecord(RECORD(ctx, j), RECORD(ctx, j - 1), ctx->size);
+                j--;
+            } while (j > low && Less(ctx, ctx->temp, RECORD(ctx, j - 1)));
+            CopyRecord(RECORD(ctx, j), ctx->temp, ctx->size);
+        }
+    }
+}
+
+static void ShellSortEx(SortContext *ctx, size_t n) {
+    for (size_t dk = n / 2; dk >= 1; dk = dk / 2) {
+        for (size_t i = dk; i < n; i++) {
+            if (Less(ctx, RECORD(ctx, i), RECORD(ctx, i - dk))) {
+                CopyRecord(ctx->temp, RECORD(ctx, i), ctx->size);
+                size_t j = i;
+                do {
+                    CopyRecord(RECORD(ctx, j), RECORD(ctx, j - dk), ctx->size);
+                    j -= dk;
+                } while (j >= dk && Less(ctx, ctx->temp, RECORD(ctx, j - dk)));
+                CopyRecord(RECORD(ctx, j), ctx->temp, ctx->size);
+            }
+        }
+    }
+}
+
+// Sift record k down within the heap base[low..low+len)
+static void HeapAdjustEx(SortContext *ctx, size_t low, size_t k, size_t len) {
+    CopyRecord(ctx->temp, RECORD(ctx, low + k), ctx->size);
+    for (size_t i = 2 * k + 1; i < len; i = 2 * i + 1) {
+        if (i + 1 < len && Less(ctx, RECORD(ctx, low + i), RECORD(ctx, low + i + 1))) i++;
+        if (!Less(ctx, ctx->temp, RECORD(ctx, low + i))) break;
+        CopyRecord(RECORD(ctx, low + k), RECORD(ctx, low + i), ctx->size);
+        k = i;
+    }
+    CopyRecord(RECORD(ctx, low + k), ctx->temp, ctx->size);
+}
+
+static void HeapSortEx(SortContext *ctx, size_t low, size_t n) {
+    for (size_t i = n / 2; i-- > 0;) {
+        HeapAdjustEx(ctx, low, i, n);
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+        SwapRecord(ctx, low, low + i);
+        HeapAdjustEx(ctx, low, 0, i);
+    }
+}
+
+static void QuickSortEx(SortContext *ctx, size_t low, size_t n, int depthLimit) {
+    while (n > SORT_EX_CUTOFF) {
+        if (depthLimit-- == 0) {
+            HeapSortEx(ctx, low, n);
+            return;
+        }
+        size_t mid = low + n / 2, last = low + n - 1;
+        if (Less(ctx, RECORD(ctx, mid), RECORD(ctx, low))) SwapRecord(ctx, mid, low);
+        if (Less(ctx, RECORD(ctx, last), RECORD(ctx, mid))) {
+            SwapRecord(ctx, last, mid);
+            if (Less(ctx, RECORD(ctx, mid), RECORD(ctx, low))) SwapRecord(ctx, mid, low);
+        }
+        CopyRecord(ctx->pivot, RECORD(ctx, mid), ctx->size);
+        CopyRecord(RECORD(ctx, mid), RECORD(ctx, low), ctx->size);
+
+        size_t i = low, j = last;
+        while (i < j) {
+            while (i < j && Less(ctx, ctx->pivot, RECORD(ctx, j))) j--;
+            if (i < j) CopyRecord(RECORD(ctx, i++), RECORD(ctx, j), ctx->size);
+            while (i < j && Less(ctx, RECORD(ctx, i), ctx->pivot)) i++;
+            if (i < j) CopyRecord(RECORD(ctx, j--), RECORD(ctx, i), ctx->size);
+        }
+        CopyRecord(RECORD(ctx, i), ctx->pivot, ctx->size);
+
+        size_t left = i - low, right = low + n - i - 1;
+        if (left < right) {
+            QuickSortEx(ctx, low, left, depthLimit);
+            low = i + 1;
+            n = right;
+        } else {
+            QuickSortEx(ctx, i + 1, right, depthLimit);
+            n = left;
+        }
+    }
+    InsertSortEx(ctx, low, n);
+}
+
+static void MergeSortEx(SortContext *ctx, size_t low, size_t n) {
+    if (n <= SORT_EX_CUTOFF) {
+        InsertSortEx(ctx, low, n);
+        return;
+    }
+    size_t half = n / 2;
+    MergeSortEx(ctx, low, half);
+    MergeSortEx(ctx, low + half, n - half);
+    if (!Less(ctx, RECORD(ctx, low + half), RECORD(ctx, low + half - 1))) return;
+
+    size_t size = ctx->size;
+    memcpy(ctx->buffer, RECORD(ctx, low), half * size);
+    char *i = ctx->buffer, *iEnd = ctx->buffer + half * size;
+    char *j = RECORD(ctx, low + half), *jEnd = RECORD(ctx, low + n);
+    char *k = RECORD(ctx, low);
+    while (i < iEnd && j < jEnd) {
+        if (!Less(ctx, j, i)) {
+            CopyRecord(k, i, size);
+            i += size;
+        } else {
+            CopyRecord(k, j, size);
+            j += size;
+        }
+        k += size;
+    }
+    memcpy(k, i, iEnd - i);
+}
+
+int SortEx(void *base, size_t n, size_t size, SortCompare cmp, SortAlgorithm algo) {
+    if ((base == NULL && n > 0) || size == 0 || cmp == NULL) return 0;
+    if (n < 2) return 1;
+
+    SortContext ctx;
+    ctx.base = (char *)base;
+    ctx.size = size;
+    ctx.cmp = cmp;
+    ctx.temp = (char *)malloc(2 * size);
+    if (!ctx.temp) return 0;
+    ctx.pivot = ctx.temp + size;
+    ctx.buffer = NULL;
+
+    int ok = 1;
+    switch (algo) {
+        case SORT_INSERT:
+            InsertSortEx(&ctx, 0, n);
+            break;
+        case SORT_SHELL:
+            ShellSortEx(&ctx, n);
+            break;
+        case SORT_QUICK: {
+            int depthLimit = 0;
+            for (size_t m = n; m > 1; m >>= 1) depthLimit += 2;
+            QuickSortEx(&ctx, 0, n, depthLimit);
+            break;
+        }
+        case SORT_HEAP:
+            HeapSortEx(&ctx, 0, n);
+            break;
+        case SORT_MERGE:
+            ctx.buffer = (char *)malloc((n / 2) * size);
+            if (!ctx.buffer) {
+                ok = 0;
+                break;
+            }
+            MergeSortEx(&ctx, 0, n);
+            free(ctx.buffer);
+            break;
+        default:
+            ok = 0;
+            break;
+    }
+
+    free(ctx.temp);
+    return ok;
+}
@@ -0,0 +1,8 @@
+#include "include/sort/sort_stats.h"
+
+SortStats sortStats;
+
+void ResetSortStats(void) {
+    sortStats.compares = 0;
+    sortStats.moves = 0;
+}
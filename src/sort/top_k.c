@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/sort/top_k.h"
+#include "include/sort/quick_sort.h"
+#include "include/sort/heap_sort.h"
+#include "include/sort/insert_sort.h"
+
+/*
+ * Selection on the quick sort partitioner
+ *
+ * NthElement is introselect: median-of-three pivots and Partition from
+ * quick_sort.c, keeping only the side that holds k. Every
+ * SELECT_HALVING_ROUNDS rounds the range has to shrink to half its size,
+ * and when it does not, the next round takes a median-of-medians pivot,
+ * which leaves at most about 7/10 of the range. Either way a constant
+ * number of linear rounds shrinks the range by a constant factor, so the
+ * worst case is O(n).
+ */
+
+#define SELECT_CUTOFF 16
+#define SELECT_HALVING_ROUNDS 3
+#define TOP_K_INITIAL_CAPACITY 64
+
+static void Select(int *a, int low, int high, int k, int medians);
+
+static void SwapInt(int *a, int i, int j) {
+    int temp = a[i];
+    a[i] = a[j];
+    a[j] = temp;
+}
+
+static int MedianOfThree(int *a, int i, int j, int k) {
+    if (a[i] < a[j]) {
+        if (a[j] < a[k]) return j;
+        return a[i] < a[k] ? k : i;
+    }
+    if (a[i] < a[k]) return i;
+    return a[j] < a[k] ? k : j;
+}
+
+// Median of the medians of groups of five, gathered at the front of the range
+static int MedianOfMedians(int *a, int low, int high) {
+    int m = 0;
+    for (int i = low; i <= high; i += 5) {
+        int len = high - i + 1 < 5 ? high - i + 1 : 5;
+        InsertSort(a + i, len);
+        SwapInt(a, low + m, i + len / 2);
+        m++;
+    }
+    Select(a, low, low + m - 1, low + m / 2, 1);
+    return low + m / 2;
+}
+
+// medians: take every pivot by median-of-medians
+static void Select(int *a, int low, int high, int k, int medians) {
+    int rounds = 0, checkSize = high - low + 1, behind = 0;
+    while (high - low + 1 > SELECT_CUTOFF) {
+        int p;
+        if (medians || behind) {
+            p = MedianOfMedians(a, low, high);
+        } else {
+            p = MedianOfThree(a, low, low + (high - low) / 2, high);
+        }
+        SwapInt(a, low, p);
+        int pivotpos = Partition(a, low, high);
+        if (pivotpos == k) return;
+        if (k < pivotpos) {
+            high = pivotpos - 1;
+        } else {
+            low = pivotpos + 1;
+        }
+        if (behind) {
+            behind = 0;
+            checkSize = high - low + 1;
+        } else if (!medians && ++rounds == SELECT_HALVING_ROUNDS) {
+            behind = high - low + 1 > checkSize / 2;
+            checkSize = high - low + 1;
+            rounds = 0;
+        }
+    }
+    InsertSort(a + low, high - low + 1);
+}
+
+void NthElement(int *a, int n, int k) {
+    if (k < 0 || k >= n) return;
+    Select(a, 0, n - 1, k, 0);
+}
+
+void PartialSort(int *a, int n, int k) {
+    if (k > n) k = n;
+    if (k <= 0) return;
+    if (k < n) NthElement(a, n, k - 1);
+    QuickSort(a, 0, k - 1);
+}
+
+int InitTopK(TopK *T, int k) {
+    T->length = 0;
+    T->k = k;
+    T->capacity = k < TOP_K_INITIAL_CAPACITY ? k : TOP_K_INITIAL_CAPACITY;
+    T->data = NULL;
+    if (k <= 0) return 0;
+    T->data = (int *)malloc(T->capacity * sizeof(int));
+    return T->data != NULL;
+}
+
+void TopKPush(TopK *T, int x) {
+    // Nothing to keep: k <= 0, or InitTopK could not allocate
+    if (T->k <= 0 || !T->data) return;
+    if (T->length < T->k) {
+        if (T->length == T->capacity) {
+            int capacity = T->capacity * 2 < T->k ? T->capacity * 2 : T->k;
+            int *data = (int *)realloc(T->data, capacity * sizeof(int));
+            if (!data) return;
+            T->data = data;
+            T->capacity = capacity;
+        }
+        int i = T->length++;
+        while (i > 0 && T->data[(i - 1) / 2] < x) {
+            T->data[i] = T->data[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        T->data[i] = x;
+    } else if (x < T->data[0]) {
+        T->data[0] = x;
+        HeapAdjust(T->data, 0, T->length);
+    }
+}
+
+int TopKResult(TopK *T, int *out) {
+    if (T->length == 0) return 0;
+    memcpy(out, T->data, T->length * sizeof(int));
+    HeapSort(out, T->length);
+    return T->length;
+}
+
+void DestroyTopK(TopK *T) {
+    free(T->data);
+    T->data = NULL;
+    T->length = T->capacity = 0;
+}
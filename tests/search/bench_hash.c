@@ -0,0 +1,330 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/search/concurrent_hash.h"
+#include "include/search/hash_table.h"
+#include "include/search/swiss_map.h"
+
+/*
+ * Hash table benchmarks
+ *
+ * Usage: bench_hash churn [ops] [size]
+ *        bench_hash concurrent [ops] [keys] [max_threads]
+ *        bench_hash batch [max_keys] [lookups]
+ *        bench_hash swiss [max_keys] [lookups]
+ */
+
+#define LOOKUPS 200000
+#define INTERVALS 20
+#define BATCH_REQUEST 1024
+// Keys wrap before reaching the NULLKEY/DELKEY sentinels
+#define CHURN_KEY(i) ((int)((i) % 2000000000LL))
+
+unsigned int seed = 2463534242u;
+
+unsigned int NextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+double NowSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Steady-state churn: size keys stay live while every step deletes the
+ * oldest key and inserts a new one. Each interval reports the cost of
+ * the updates and of lookups that hit and miss, so tombstone buildup
+ * shows as latency that grows over time.
+ */
+void BenchChurn(long long ops, int size) {
+    const char *modes[] = {"linear", "robin hood"};
+    long long step = ops / 2 / INTERVALS;
+    printf("%lld ops (inserts + deletes), %d live keys\n", ops, size);
+    for (int m = 0; m < 2; m++) {
+        HashTable H;
+        if (m == 0) {
+            InitHashTable(&H, size);
+        } else {
+            InitRobinHoodHashTable(&H, size);
+        }
+        for (int i = 0; i < size; i++) {
+            InsertHash(&H, i);
+        }
+        long long next = size;
+        seed = 2463534242u;
+        printf("\n%s\n%12s %12s %12s %12s %10s %10s\n", modes[m], "ops", "update ns", "hit ns", "miss ns",
+               "used", "length");
+        for (int interval = 0; interval < INTERVALS; interval++) {
+            double start = NowSeconds();
+            for (long long j = 0; j < step; j++, next++) {
+                DeleteHash(&H, CHURN_KEY(next - size));
+                InsertHash(&H, CHURN_KEY(next));
+            }
+            double update = NowSeconds() - start;
+
+            int hits = 0;
+            start = NowSeconds();
+            for (int j = 0; j < LOOKUPS; j++) {
+                hits += SearchHash(H, CHURN_KEY(next - 1 - NextRandom() % size)) != -1;
+            }
+            double hit = NowSeconds() - start;
+            start = NowSeconds();
+            for (int j = 0; j < LOOKUPS; j++) {
+                hits += SearchHash(H, CHURN_KEY(next + NextRandom() % size)) != -1;
+            }
+            double miss = NowSeconds() - start;
+
+            printf("%12lld %12.1f %12.1f %12.1f %10d %10d%s\n", 2 * step * (interval + 1),
+                   update * 1e9 / (2 * step), hit * 1e9 / LOOKUPS, miss * 1e9 / LOOKUPS, H.used, H.length,
+                   hits == LOOKUPS && H.count == size ? "" : " WRONG");
+            fflush(stdout);
+        }
+        DestroyHashTable(&H);
+    }
+}
+
+/*
+ * Shared map under a read/write mix: each thread draws keys from
+ * [0, keys) and looks them up, inserts or deletes them in the given
+ * proportion. The baseline is HashTable behind one mutex.
+ */
+typedef struct {
+    ConcurrentHashMap *map;
+    HashTable *table;
+    pthread_mutex_t *lock;
+    long long ops;
+    int keys;
+    int readPercent;
+    unsigned int seed;
+    long long hits;
+} MixJob;
+
+void *RunMix(void *arg) {
+    MixJob *job = (MixJob *)arg;
+    int thread = job->map ? ConcurrentHashRegister(job->map) : 0;
+    unsigned int x = job->seed;
+    // Counted locally: jobs sit next to each other, so a shared counter
+    // would bounce one cache line between the threads
+    long long hits = 0;
+    for (long long i = 0; i < job->ops; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int key = (int)(x >> 8) % job->keys;
+        // 16 bits keep the modulo bias under 0.1%; with 8 bits a 50% mix read 59%
+        int op = (int)((x ^ x >> 16) & 0xffff) % 100;
+        int value;
+        if (job->map) {
+            if (op < job->readPercent) {
+                hits += ConcurrentHashFind(job->map, thread, key, &value);
+            } else if (op & 1) {
+                ConcurrentHashInsert(job->map, thread, key, key);
+            } else {
+                ConcurrentHashDelete(job->map, thread, key);
+            }
+        } else {
+            pthread_mutex_lock(job->lock);
+            if (op < job->readPercent) {
+                hits += SearchHash(*job->table, key) != -1;
+            } else if (op & 1) {
+                InsertHash(job->table, key);
+            } else {
+                DeleteHash(job->table, key);
+            }
+            pthread_mutex_unlock(job->lock);
+        }
+    }
+    job->hits = hits;
+    return NULL;
+}
+
+void BenchConcurrent(long long ops, int keys, int maxThreads) {
+    const int readPercents[] = {95, 50};
+    MixJob jobs[CONCURRENT_MAX_THREADS];
+    pthread_t threads[CONCURRENT_MAX_THREADS];
+    if (maxThreads > CONCURRENT_MAX_THREADS) maxThreads = CONCURRENT_MAX_THREADS;
+    printf("%lld ops over %d keys, half of them present\n", ops, keys);
+    for (int r = 0; r < 2; r++) {
+        printf("\n%d%% reads\n%8s %16s %16s\n", readPercents[r], "threads", "concurrent Mops", "mutex Mops");
+        for (int n = 1; n <= maxThreads; n *= 2) {
+            double mops[2];
+            for (int m = 0; m < 2; m++) {
+                ConcurrentHashMap map;
+                HashTable table;
+                pthread_mutex_t lock;
+                if (m == 0) {
+                    ConcurrentHashInit(&map, keys);
+                    int thread = ConcurrentHashRegister(&map);
+                    for (int key = 0; key < keys; key += 2) {
+                        ConcurrentHashInsert(&map, thread, key, key);
+                    }
+                } else {
+                    InitHashTable(&table, keys);
+                    pthread_mutex_init(&lock, NULL);
+                    for (int key = 0; key < keys; key += 2) {
+                        InsertHash(&table, key);
+                    }
+                }
+                double start = NowSeconds();
+                for (int i = 0; i < n; i++) {
+                    jobs[i] = (MixJob){m == 0 ? &map : NULL, &table, &lock, ops / n, keys,
+                                       readPercents[r], 2463534242u + 7919u * i, 0};
+                    pthread_create(&threads[i], NULL, RunMix, &jobs[i]);
+                }
+                for (int i = 0; i < n; i++) {
+                    pthread_join(threads[i], NULL);
+                }
+                mops[m] = ops / n * n / (NowSeconds() - start) / 1e6;
+                if (m == 0) {
+                    ConcurrentHashDestroy(&map);
+                } else {
+                    DestroyHashTable(&table);
+                    pthread_mutex_destroy(&lock);
+                }
+            }
+            printf("%8d %16.2f %16.2f\n", n, mops[0], mops[1]);
+            fflush(stdout);
+        }
+    }
+}
+
+/*
+ * One key at a time vs SearchHashBatch, over tables from cache-resident
+ * to far past the last-level cache. Queries come in requests of
+ * BATCH_REQUEST random keys, half of them present.
+ */
+void BenchBatch(int maxKeys, int lookups) {
+    const char *modes[] = {"linear", "robin hood"};
+    int *keys = (int *)malloc(lookups * sizeof(int));
+    int *out = (int *)malloc(BATCH_REQUEST * sizeof(int));
+    printf("%d lookups per table size, %d keys per batch\n", lookups, BATCH_REQUEST);
+    printf("%-12s %10s %10s %12s %12s %8s\n", "mode", "keys", "length", "single ns", "batch ns", "speedup");
+    for (int m = 0; m < 2; m++) {
+        for (int size = 4096; size <= maxKeys; size *= 8) {
+            HashTable H;
+            if (m == 0) {
+                InitHashTable(&H, size);
+            } else {
+                InitRobinHoodHashTable(&H, size);
+            }
+            for (int i = 0; i < size; i++) {
+                InsertHash(&H, i);
+            }
+            seed = 2463534242u;
+            for (int i = 0; i < lookups; i++) {
+                keys[i] = (int)(NextRandom() % (2u * size));
+            }
+
+            long long hits = 0;
+            double start = NowSeconds();
+            for (int i = 0; i < lookups; i++) {
+                hits += SearchHash(H, keys[i]) != -1;
+            }
+            double single = NowSeconds() - start;
+            start = NowSeconds();
+            for (int i = 0; i < lookups; i += BATCH_REQUEST) {
+                int n = lookups - i < BATCH_REQUEST ? lookups - i : BATCH_REQUEST;
+                hits -= SearchHashBatch(&H, keys + i, n, out);
+            }
+            double batch = NowSeconds() - start;
+
+            printf("%-12s %10d %10d %12.1f %12.1f %7.2fx%s\n", modes[m], size, H.length,
+                   single * 1e9 / lookups, batch * 1e9 / lookups, single / batch, hits == 0 ? "" : " WRONG");
+            fflush(stdout);
+            DestroyHashTable(&H);
+        }
+    }
+    free(keys);
+    free(out);
+}
+
+/*
+ * SwissMap against HashTable on int keys. Both get the keys [0, size)
+ * in random order, then lookups of random keys from [0, 2 * size), so
+ * half of them hit. SwissMap also stores an int value per key.
+ */
+void BenchSwiss(int maxKeys, int lookups) {
+    int *order = (int *)malloc(maxKeys * sizeof(int));
+    int *keys = (int *)malloc(lookups * sizeof(int));
+    printf("%d lookups per table size, half of them hits\n", lookups);
+    printf("%10s %14s %14s %14s %14s\n", "keys", "table ins ns", "swiss ins ns", "table find ns",
+           "swiss find ns");
+    for (int size = 10000; size <= maxKeys; size *= 10) {
+        seed = 2463534242u;
+        for (int i = 0; i < size; i++) {
+            order[i] = i;
+        }
+        for (int i = size - 1; i > 0; i--) {
+            int j = (int)(NextRandom() % (unsigned int)(i + 1));
+            int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+        for (int i = 0; i < lookups; i++) {
+            keys[i] = (int)(NextRandom() % (2u * size));
+        }
+
+        HashTable H;
+        InitHashTable(&H, size);
+        double start = NowSeconds();
+        for (int i = 0; i < size; i++) {
+            InsertHash(&H, order[i]);
+        }
+        double tableInsert = NowSeconds() - start;
+        long long hits = 0;
+        start = NowSeconds();
+        for (int i = 0; i < lookups; i++) {
+            hits += SearchHash(H, keys[i]) != -1;
+        }
+        double tableFind = NowSeconds() - start;
+        DestroyHashTable(&H);
+
+        SwissMap map;
+        SwissMapInit(&map, sizeof(int), sizeof(int), size);
+        start = NowSeconds();
+        for (int i = 0; i < size; i++) {
+            SwissMapInsert(&map, &order[i], &order[i]);
+        }
+        double swissInsert = NowSeconds() - start;
+        start = NowSeconds();
+        for (int i = 0; i < lookups; i++) {
+            hits -= SwissMapFind(&map, &keys[i]) != NULL;
+        }
+        double swissFind = NowSeconds() - start;
+        SwissMapDestroy(&map);
+
+        printf("%10d %14.1f %14.1f %14.1f %14.1f%s\n", size, tableInsert * 1e9 / size, swissInsert * 1e9 / size,
+               tableFind * 1e9 / lookups, swissFind * 1e9 / lookups, hits == 0 ? "" : " WRONG");
+        fflush(stdout);
+    }
+    free(order);
+    free(keys);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = argc > 1 ? argv[1] : "churn";
+    if (strcmp(mode, "churn") == 0) {
+        BenchChurn(argc > 2 ? atoll(argv[2]) : 100000000LL, argc > 3 ? atoi(argv[3]) : 1000000);
+    } else if (strcmp(mode, "concurrent") == 0) {
+        BenchConcurrent(argc > 2 ? atoll(argv[2]) : 20000000LL, argc > 3 ? atoi(argv[3]) : 1000000,
+                        argc > 4 ? atoi(argv[4]) : 64);
+    } else if (strcmp(mode, "batch") == 0) {
+        BenchBatch(argc > 2 ? atoi(argv[2]) : 16777216, argc > 3 ? atoi(argv[3]) : 10000000);
+    } else if (strcmp(mode, "swiss") == 0) {
+        BenchSwiss(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? atoi(argv[3]) : 10000000);
+    } else {
+        printf("Usage: %s churn [ops] [size]\n", argv[0]);
+        printf("       %s concurrent [ops] [keys] [max_threads]\n", argv[0]);
+        printf("       %s batch [max_keys] [lookups]\n", argv[0]);
+        printf("       %s swiss [max_keys] [lookups]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "include/search/concurrent_hash.h"
+
+#define THREADS 8
+#define KEYS_PER_THREAD 100000
+
+ConcurrentHashMap map;
+int writersDone;
+int readerErrors;
+
+// Each writer owns the keys congruent to its index mod THREADS
+void *Writer(void *arg) {
+    int index = (int)(long)arg;
+    int thread = ConcurrentHashRegister(&map);
+    for (int i = 0; i < KEYS_PER_THREAD; i++) {
+        int key = i * THREADS + index;
+        ConcurrentHashInsert(&map, thread, key, key * 2);
+    }
+    for (int i = 0; i < KEYS_PER_THREAD; i += 2) {
+        ConcurrentHashDelete(&map, thread, i * THREADS + index);
+    }
+    __atomic_fetch_add(&writersDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Keys at odd positions are never deleted: once the reader has seen one of
+// writer 0's it must stay, with the right value
+void *Reader(void *arg) {
+    (void)arg;
+    int thread = ConcurrentHashRegister(&map);
+    int next = THREADS;
+    while (__atomic_load_n(&writersDone, __ATOMIC_ACQUIRE) < THREADS) {
+        for (int key = THREADS; key < next; key += 2 * THREADS * 64) {
+            int value;
+            if (!ConcurrentHashFind(&map, thread, key, &value) || value != key * 2) {
+                __atomic_fetch_add(&readerErrors, 1, __ATOMIC_RELAXED);
+            }
+        }
+        int value;
+        while (ConcurrentHashFind(&map, thread, next, &value)) {
+            if (value != next * 2) __atomic_fetch_add(&readerErrors, 1, __ATOMIC_RELAXED);
+            next += 2 * THREADS;
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    printf("=== Concurrent Hash Map Test ===\n");
+
+    ConcurrentHashInit(&map, 16);
+    int thread = ConcurrentHashRegister(&map);
+    int value;
+    printf("Insert 5 -> 50, 7 -> 70, then 5 -> 55\n");
+    ConcurrentHashInsert(&map, thread, 5, 50);
+    ConcurrentHashInsert(&map, thread, 7, 70);
+    ConcurrentHashInsert(&map, thread, 5, 55);
+    printf("Find 5: %s\n", ConcurrentHashFind(&map, thread, 5, &value) && value == 55 ? "55" : "wrong");
+    int erased = ConcurrentHashDelete(&map, thread, 7);
+    printf("Delete 7: %s, find 7: %s, count: %d\n", erased ? "Yes" : "No",
+           ConcurrentHashFind(&map, thread, 7, &value) ? "Found" : "Not found", ConcurrentHashCount(&map));
+    ConcurrentHashDelete(&map, thread, 5);
+
+    printf("\n%d writers insert %d keys each and delete half, one reader checks them\n",
+           THREADS, KEYS_PER_THREAD);
+    pthread_t writers[THREADS], reader;
+    pthread_create(&reader, NULL, Reader, NULL);
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&writers[i], NULL, Writer, (void *)(long)i);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    pthread_join(reader, NULL);
+
+    int present = 0, wrong = 0, deleted = 0;
+    for (int key = 0; key < THREADS * KEYS_PER_THREAD; key++) {
+        if (ConcurrentHashFind(&map, thread, key, &value)) {
+            if ((key / THREADS) % 2 == 0) {
+                deleted++;
+            } else {
+                present++;
+                wrong += value != key * 2;
+            }
+        }
+    }
+    printf("Present: %d, wrong values: %d, deleted keys found: %d, count: %d, reader errors: %d\n",
+           present, wrong, deleted, ConcurrentHashCount(&map), readerErrors);
+    printf("Result: %s\n", present == THREADS * KEYS_PER_THREAD / 2 && wrong == 0 && deleted == 0 &&
+           ConcurrentHashCount(&map) == present && readerErrors == 0 ? "VERIFIED ✓" : "FAILED ✗");
+
+    ConcurrentHashDestroy(&map);
+    return 0;
+}
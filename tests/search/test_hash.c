@@ -29,7 +29,120 @@ int main() {
     DeleteHash(&H, 14);
     PrintHashTable(H);
 
-    free(H.elem);
+    DestroyHashTable(&H);
+
+    // Multiples of 13 all hit one home slot under key % 13
+    int n = 1000000;
+    printf("\nInsert %d multiples of 13\n", n);
+    InitHashTable(&H, 16);
+    int inserted = 0;
+    for (int i = 0; i < n; i++) {
+        inserted += InsertHash(&H, i * 13);
+    }
+    printf("Inserted: %d, count: %d, length: %d\n", inserted, H.count, H.length);
+    printf("Duplicate insert rejected: %s\n", InsertHash(&H, 13) ? "No" : "Yes");
+
+    for (int i = 0; i < n; i += 2) {
+        DeleteHash(&H, i * 13);
+    }
+    int found = 0, stale = 0;
+    long long probes = 0;
+    for (int i = 0; i < n; i++) {
+        int addr = SearchHash(H, i * 13);
+        if (addr == -1) continue;
+        if (i % 2 == 0) {
+            stale++;
+        } else {
+            found++;
+            if (addr < H.length) {
+                probes += ((addr - (int)(Hash(i * 13) & (H.length - 1))) & (H.length - 1)) + 1;
+            }
+        }
+    }
+    printf("After deleting every other key: %d found, %d deleted keys found, count: %d\n",
+           found, stale, H.count);
+    printf("Average probe length: %.2f\n", found ? (double)probes / found : 0.0);
+
+    // Insert and delete fresh keys; tombstones must not pile up
+    for (int i = 0; i < 4 * n; i++) {
+        InsertHash(&H, -3 - i);
+        DeleteHash(&H, -3 - i);
+    }
+    printf("After %d insert/delete pairs: count: %d, length: %d, used slots: %d\n",
+           4 * n, H.count, H.length, H.used);
+
+    DestroyHashTable(&H);
+
+    printf("\n=== Robin Hood Mode ===\n");
+    InitRobinHoodHashTable(&H, 16);
+    for (int i = 0; i < n; i++) {
+        InsertHash(&H, i * 13);
+    }
+    for (int i = 0; i < n; i += 2) {
+        DeleteHash(&H, i * 13);
+    }
+    for (int i = 0; i < 4 * n; i++) {
+        InsertHash(&H, -3 - i);
+        DeleteHash(&H, -3 - i);
+    }
+    found = 0;
+    stale = 0;
+    for (int i = 0; i < n; i++) {
+        int addr = SearchHash(H, i * 13);
+        if (addr == -1) continue;
+        if (i % 2 == 0) {
+            stale++;
+        } else {
+            found++;
+        }
+    }
+    int tombstones = 0, maxDist = 0;
+    probes = 0;
+    for (int i = 0; i < H.length; i++) {
+        if (H.elem[i] == DELKEY) tombstones++;
+        if (H.dist[i] > maxDist) maxDist = H.dist[i];
+        probes += H.dist[i];
+    }
+    printf("After deletes and %d insert/delete pairs: %d found, %d deleted keys found, count: %d\n",
+           4 * n, found, stale, H.count);
+    printf("Tombstones: %d, used slots: %d, average probe length: %.2f, longest: %d\n",
+           tombstones, H.used, H.count ? (double)probes / H.count : 0.0, maxDist);
+
+    DestroyHashTable(&H);
+
+    printf("\n=== Batched Lookup ===\n");
+    const char *modes[] = {"Linear probing", "Robin Hood"};
+    int *keys = (int *)malloc(4 * n * sizeof(int));
+    int *out = (int *)malloc(4 * n * sizeof(int));
+    for (int m = 0; m < 2; m++) {
+        if (m == 0) {
+            InitHashTable(&H, 16);
+        } else {
+            InitRobinHoodHashTable(&H, 16);
+        }
+        // Stop in the middle of a rehash so that some keys are only in oldElem
+        int stored = 0;
+        while (stored < n || !H.oldElem) {
+            InsertHash(&H, stored++ * 7);
+        }
+        int queries = 2 * stored + 2;
+        for (int i = 0; i < 2 * stored; i++) {
+            keys[i] = i * 7;
+        }
+        keys[2 * stored] = NULLKEY;
+        keys[2 * stored + 1] = DELKEY;
+        found = SearchHashBatch(&H, keys, queries, out);
+        int same = 1, old = 0;
+        for (int i = 0; i < queries; i++) {
+            same &= out[i] == SearchHash(H, keys[i]);
+            old += out[i] >= H.length;
+        }
+        printf("%s: %d of %d keys found (%d in the old array), same as SearchHash: %s\n",
+               modes[m], found, queries, old, same && found == stored ? "Yes" : "No");
+        DestroyHashTable(&H);
+    }
+    free(keys);
+    free(out);
 
     return 0;
 }
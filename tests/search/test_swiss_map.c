@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/search/swiss_map.h"
+
+typedef struct {
+    char name[12];
+    int id;
+} Point;
+
+double NowSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+    printf("=== Swiss Map Test ===\n");
+
+    SwissMap map;
+    SwissMapInit(&map, sizeof(int), sizeof(int), 0);
+
+    int keys[] = {19, 14, 23, 1, 68, -1, -2, 0};
+    printf("Insert keys: 19, 14, 23, 1, 68, -1, -2, 0 with value key * 10\n");
+    for (int i = 0; i < 8; i++) {
+        int value = keys[i] * 10;
+        SwissMapInsert(&map, &keys[i], &value);
+    }
+    int key = -1, value = 7;
+    SwissMapInsert(&map, &key, &value);
+    printf("Overwrite -1 with 7, count: %zu\n", map.count);
+
+    size_t iter = 0;
+    const void *k;
+    void *v;
+    while (SwissMapNext(&map, &iter, &k, &v)) {
+        printf("%d -> %d\n", *(const int *)k, *(int *)v);
+    }
+
+    key = -2;
+    int *found = (int *)SwissMapFind(&map, &key);
+    printf("\nFind -2: %s\n", found ? "Found" : "Not found");
+    key = 99;
+    printf("Find 99: %s\n", SwissMapFind(&map, &key) ? "Found" : "Not found");
+    key = 14;
+    int erased = SwissMapErase(&map, &key);
+    printf("Erase 14: %s, find 14: %s\n", erased ? "Yes" : "No", SwissMapFind(&map, &key) ? "Found" : "Not found");
+    SwissMapDestroy(&map);
+
+    int n = 1000000;
+    printf("\nInsert %d multiples of 13\n", n);
+    SwissMapInit(&map, sizeof(int), sizeof(int), 0);
+    for (int i = 0; i < n; i++) {
+        key = i * 13;
+        value = i;
+        SwissMapInsert(&map, &key, &value);
+    }
+    printf("count: %zu, capacity: %zu\n", map.count, map.capacity);
+
+    int correct = 0;
+    double start = NowSeconds();
+    for (int i = 0; i < n; i++) {
+        key = i * 13;
+        found = (int *)SwissMapFind(&map, &key);
+        correct += found && *found == i;
+    }
+    double seconds = NowSeconds() - start;
+    printf("Found with the right value: %d (%.1f ns per lookup)\n", correct, seconds * 1e9 / n);
+
+    for (int i = 0; i < n; i += 2) {
+        key = i * 13;
+        SwissMapErase(&map, &key);
+    }
+    int present = 0;
+    for (int i = 0; i < n; i++) {
+        key = i * 13;
+        present += SwissMapFind(&map, &key) != NULL;
+    }
+    long long sum = 0;
+    iter = 0;
+    while (SwissMapNext(&map, &iter, &k, &v)) {
+        sum += *(int *)v;
+    }
+    printf("After erasing every other key: %d present, count: %zu, value sum %s\n", present, map.count,
+           sum == 250000000000LL ? "correct" : "wrong");
+
+    // Churn with fresh keys; tombstones are reclaimed without growing
+    for (int i = 0; i < 4 * n; i++) {
+        key = -1 - i;
+        SwissMapInsert(&map, &key, &i);
+        SwissMapErase(&map, &key);
+    }
+    printf("After %d insert/erase pairs: count: %zu, capacity: %zu\n", 4 * n, map.count, map.capacity);
+    SwissMapDestroy(&map);
+
+    // 16-byte struct keys, compared bytewise
+    printf("\nStruct keys\n");
+    SwissMapInit(&map, sizeof(Point), sizeof(double), 0);
+    Point p;
+    memset(&p, 0, sizeof(p));
+    for (int i = 0; i < 1000; i++) {
+        snprintf(p.name, sizeof(p.name), "point%d", i % 10);
+        p.id = i;
+        double weight = i * 0.5;
+        SwissMapInsert(&map, &p, &weight);
+    }
+    snprintf(p.name, sizeof(p.name), "point%d", 7);
+    p.id = 507;
+    double *weight = (double *)SwissMapFind(&map, &p);
+    printf("count: %zu, find {point7, 507}: %.1f\n", map.count, weight ? *weight : -1.0);
+    SwissMapDestroy(&map);
+
+    return 0;
+}
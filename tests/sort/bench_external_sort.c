@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/sort/external_sort.h"
+#include "include/sort/async_io.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define BENCH_RLIMIT 1
+#endif
+
+/*
+ * External sort benchmarks
+ *
+ * Writes its temporary files into the current directory.
+ *
+ * Usage: bench_external_sort merge [k] [per_run]
+ *        bench_external_sort runs [n]
+ *        bench_external_sort budget [n]
+ *        bench_external_sort io [n] [memory_mb]
+ *        bench_external_sort threads [n] [memory_mb] [max_threads]
+ *        bench_external_sort compress [n] [memory_mb]
+ *        bench_external_sort records [n] [memory_mb]
+ *        bench_external_sort suite [size_mb] [memory_mb...] [--limit-mb mb]
+ */
+
+unsigned int seed = 2463534242u;
+
+unsigned int NextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+double NowSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int CompareInt(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+// Check that a file of ints is sorted and holds the expected count
+int VerifyFile(const char *filename, long expected) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return 0;
+    int buffer[MEMORY_BUFFER];
+    int prev = 0, count, sorted = 1;
+    long total = 0;
+    while ((count = (int)fread(buffer, sizeof(int), MEMORY_BUFFER, file)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (total + i > 0 && buffer[i] < prev) sorted = 0;
+            prev = buffer[i];
+        }
+        total += count;
+    }
+    fclose(file);
+    return sorted && total == expected;
+}
+
+int OpenRuns(RunFile *runs, int k) {
+    for (int i = 0; i < k; i++) {
+        char filename[100];
+        sprintf(filename, "bench_run_%d.tmp", i);
+        if (!OpenRunFile(&runs[i], filename, MEMORY_BUFFER)) return 0;
+    }
+    return 1;
+}
+
+void CloseRuns(RunFile *runs, int k) {
+    for (int i = 0; i < k; i++) {
+        CloseRunFile(&runs[i]);
+    }
+}
+
+const char *inputNames[] = {"random", "sorted", "reverse", "few-unique", "nearly"};
+
+void WriteInput(const char *filename, long long n, int kind) {
+    FILE *file = fopen(filename, "wb");
+    int buffer[MEMORY_BUFFER];
+    for (long long i = 0; i < n; i += MEMORY_BUFFER) {
+        int count = n - i < MEMORY_BUFFER ? (int)(n - i) : MEMORY_BUFFER;
+        for (int j = 0; j < count; j++) {
+            switch (kind) {
+                case 0:  buffer[j] = (int)NextRandom(); break;
+                case 1:  buffer[j] = (int)(i + j); break;
+                case 2:  buffer[j] = (int)(n - i - j); break;
+                case 3:  buffer[j] = NextRandom() % 16; break;
+                // Sorted with one value in a hundred out of place
+                default: buffer[j] = NextRandom() % 100 ? (int)(i + j) : (int)NextRandom(); break;
+            }
+        }
+        fwrite(buffer, sizeof(int), count, file);
+    }
+    fclose(file);
+}
+
+// Run counts and I/O volume of quicksort chunks against replacement selection
+void BenchRuns(int n) {
+    const char *methods[] = {"quicksort", "replacement"};
+    long long runs[3][2], bytes[3][2];
+    double seconds[3][2];
+    int ok[3][2];
+
+    for (int kind = 0; kind < 3; kind++) {
+        for (int m = 0; m < 2; m++) {
+            WriteInput("bench_input.tmp", n, kind);
+            remove("bench_output.tmp");
+            ExternalSortSetRunGeneration(m == 0 ? RUNS_QUICKSORT : RUNS_REPLACEMENT_SELECTION);
+            ResetExternalSortStats();
+            double start = NowSeconds();
+            ExternalSort("bench_input.tmp", "bench_output.tmp");
+            seconds[kind][m] = NowSeconds() - start;
+            runs[kind][m] = externalSortStats.runs;
+            bytes[kind][m] = externalSortStats.bytesRead + externalSortStats.bytesWritten;
+            ok[kind][m] = VerifyFile("bench_output.tmp", n);
+        }
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+    ExternalSortSetRunGeneration(RUNS_QUICKSORT);
+
+    printf("\nn = %d, memory = %d ints\n", n, MEMORY_BUFFER);
+    printf("%-8s %-12s %8s %12s %14s %9s\n", "input", "runs", "count", "avg length", "I/O bytes", "time");
+    for (int kind = 0; kind < 3; kind++) {
+        for (int m = 0; m < 2; m++) {
+            printf("%-8s %-12s %8lld %12.0f %14lld %8.3fs %s\n", inputNames[kind], methods[m],
+                   runs[kind][m], runs[kind][m] ? (double)n / runs[kind][m] : 0.0,
+                   bytes[kind][m], seconds[kind][m], ok[kind][m] ? "ok" : "NOT SORTED");
+        }
+    }
+}
+
+// ExternalSortEx under several memory budgets
+void BenchBudget(int n) {
+    size_t budgets[] = {256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024};
+    const char *methods[] = {"quicksort", "replacement"};
+    WriteInput("bench_input.tmp", n, 0);
+    printf("n = %d random ints (%.1f MB)\n", n, n * 4.0 / 1e6);
+    printf("%-10s %-12s %6s %7s %14s %9s %9s\n", "memory", "runs", "count", "merges", "I/O bytes", "time", "MB/s");
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+        for (int m = 0; m < 2; m++) {
+            ExternalSortConfig cfg;
+            ExternalSortDefaultConfig(&cfg);
+            cfg.memoryBytes = budgets[b];
+            cfg.runGeneration = m == 0 ? RUNS_QUICKSORT : RUNS_REPLACEMENT_SELECTION;
+            remove("bench_output.tmp");
+            ResetExternalSortStats();
+            double start = NowSeconds();
+            int ok = ExternalSortEx("bench_input.tmp", "bench_output.tmp", &cfg);
+            double seconds = NowSeconds() - start;
+            printf("%7zu KB %-12s %6lld %7lld %14lld %8.3fs %9.1f %s\n", budgets[b] / 1024, methods[m],
+                   externalSortStats.runs, externalSortStats.merges,
+                   externalSortStats.bytesRead + externalSortStats.bytesWritten, seconds,
+                   n * 4.0 / 1e6 / seconds, ok && VerifyFile("bench_output.tmp", n) ? "ok" : "FAILED");
+        }
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+// Blocking against pipelined and memory-mapped I/O, for both run generation methods
+void BenchIo(int n, int memoryMb) {
+    const char *modes[] = {"blocking", "thread", "io_uring", "mmap"};
+    const char *methods[] = {"quicksort", "replacement"};
+    WriteInput("bench_input.tmp", n, 0);
+    AsyncIo *probe = AsyncIoCreate(ASYNC_IO_URING);
+    int haveUring = probe && AsyncIoGetBackend(probe) == ASYNC_IO_URING;
+    AsyncIoDestroy(probe);
+    printf("n = %d random ints (%.1f MB), memory %d MB, io_uring %s\n",
+           n, n * 4.0 / 1e6, memoryMb, haveUring ? "available" : "falls back to thread");
+    printf("%-10s %-12s %6s %9s %9s\n", "io", "runs", "count", "time", "MB/s");
+    for (int m = 0; m < 2; m++) {
+        for (int io = 0; io < 4; io++) {
+            ExternalSortConfig cfg;
+            ExternalSortDefaultConfig(&cfg);
+            cfg.memoryBytes = (size_t)memoryMb * 1024 * 1024;
+            cfg.runGeneration = m == 0 ? RUNS_QUICKSORT : RUNS_REPLACEMENT_SELECTION;
+            cfg.io = (ExternalSortIo)io;
+            remove("bench_output.tmp");
+            ResetExternalSortStats();
+            double start = NowSeconds();
+            int ok = ExternalSortEx("bench_input.tmp", "bench_output.tmp", &cfg);
+            double seconds = NowSeconds() - start;
+            printf("%-10s %-12s %6lld %8.3fs %9.1f %s\n", modes[io], methods[m], externalSortStats.runs,
+                   seconds, n * 4.0 / 1e6 / seconds, ok && VerifyFile("bench_output.tmp", n) ? "ok" : "FAILED");
+        }
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+// Parallel run generation and partitioned merges
+void BenchThreads(int n, int memoryMb, int maxThreads) {
+    WriteInput("bench_input.tmp", n, 0);
+    printf("n = %d random ints (%.1f MB), memory %d MB\n", n, n * 4.0 / 1e6, memoryMb);
+    printf("%-8s %6s %7s %9s %9s %9s\n", "threads", "runs", "merges", "time", "MB/s", "speedup");
+    double base = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ExternalSortConfig cfg;
+        ExternalSortDefaultConfig(&cfg);
+        cfg.memoryBytes = (size_t)memoryMb * 1024 * 1024;
+        cfg.threads = threads;
+        remove("bench_output.tmp");
+        ResetExternalSortStats();
+        double start = NowSeconds();
+        int ok = ExternalSortEx("bench_input.tmp", "bench_output.tmp", &cfg);
+        double seconds = NowSeconds() - start;
+        if (threads == 1) base = seconds;
+        printf("%-8d %6lld %7lld %8.3fs %9.1f %8.2fx %s\n", threads, externalSortStats.runs,
+               externalSortStats.merges, seconds, n * 4.0 / 1e6 / seconds, base / seconds,
+               ok && VerifyFile("bench_output.tmp", n) ? "ok" : "FAILED");
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+// Raw against delta-encoded run files, with a fan-in of 8 to force intermediate passes
+void BenchCompress(int n, int memoryMb) {
+    printf("n = %d ints (%.1f MB), memory %d MB, fan-in 8\n", n, n * 4.0 / 1e6, memoryMb);
+    printf("%-8s %-6s %6s %7s %14s %7s %9s %9s\n", "input", "runs", "count", "merges", "I/O bytes",
+           "ratio", "time", "MB/s");
+    for (int kind = 0; kind < 3; kind++) {
+        WriteInput("bench_input.tmp", n, kind);
+        for (int c = 0; c < 2; c++) {
+            ExternalSortConfig cfg;
+            ExternalSortDefaultConfig(&cfg);
+            cfg.memoryBytes = (size_t)memoryMb * 1024 * 1024;
+            cfg.maxFanIn = 8;
+            cfg.compressRuns = c;
+            remove("bench_output.tmp");
+            ResetExternalSortStats();
+            double start = NowSeconds();
+            int ok = ExternalSortEx("bench_input.tmp", "bench_output.tmp", &cfg);
+            double seconds = NowSeconds() - start;
+            double ratio = externalSortStats.encodedBytes ?
+                           externalSortStats.encodedValues * 4.0 / externalSortStats.encodedBytes : 1.0;
+            printf("%-8s %-6s %6lld %7lld %14lld %6.2fx %8.3fs %9.1f %s\n", inputNames[kind],
+                   c ? "delta" : "raw", externalSortStats.runs, externalSortStats.merges,
+                   externalSortStats.bytesRead + externalSortStats.bytesWritten, ratio, seconds,
+                   n * 4.0 / 1e6 / seconds, ok && VerifyFile("bench_output.tmp", n) ? "ok" : "FAILED");
+        }
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+// Check that records or lines of a file are in key order and count them
+int VerifyRecordFile(const char *filename, const RecordLayout *layout, long expected) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return 0;
+    char prev[256], curr[256];
+    long total = 0;
+    int sorted = 1;
+    for (;;) {
+        if (layout->format == RECORDS_FIXED) {
+            if (fread(curr, 1, layout->recordSize, file) != (size_t)layout->recordSize) break;
+            if (total > 0 && memcmp(prev + layout->keyOffset, curr + layout->keyOffset, layout->keyLength) > 0) sorted = 0;
+            memcpy(prev, curr, layout->recordSize);
+        } else {
+            if (!fgets(curr, sizeof(curr), file)) break;
+            if (total > 0 && strcmp(prev, curr) > 0) sorted = 0;
+            strcpy(prev, curr);
+        }
+        total++;
+    }
+    fclose(file);
+    return sorted && total == expected;
+}
+
+// 100-byte records with 10-byte keys (gensort layout) and random text lines
+void BenchRecords(int n, int memoryMb) {
+    const char *names[] = {"100B/10B", "lines"};
+    RecordLayout layouts[2] = {{RECORDS_FIXED, 100, 0, 10}, {RECORDS_LINES, 0, 0, 0}};
+    printf("n = %d records, memory %d MB\n", n, memoryMb);
+    printf("%-9s %10s %6s %7s %9s %9s\n", "format", "MB", "runs", "merges", "time", "MB/s");
+    for (int f = 0; f < 2; f++) {
+        FILE *file = fopen("bench_input.tmp", "wb");
+        char record[100];
+        long long bytes = 0;
+        for (int i = 0; i < n; i++) {
+            if (f == 0) {
+                for (int j = 0; j < 100; j++) {
+                    record[j] = j < 10 ? (char)NextRandom() : (char)('A' + j % 26);
+                }
+                fwrite(record, 1, 100, file);
+                bytes += 100;
+            } else {
+                int length = 10 + NextRandom() % 40;
+                for (int j = 0; j < length; j++) {
+                    record[j] = (char)('a' + NextRandom() % 26);
+                }
+                record[length] = '\n';
+                fwrite(record, 1, length + 1, file);
+                bytes += length + 1;
+            }
+        }
+        fclose(file);
+
+        ExternalSortConfig cfg;
+        ExternalSortDefaultConfig(&cfg);
+        cfg.memoryBytes = (size_t)memoryMb * 1024 * 1024;
+        remove("bench_output.tmp");
+        ResetExternalSortStats();
+        double start = NowSeconds();
+        int ok = ExternalSortRecords("bench_input.tmp", "bench_output.tmp", &layouts[f], &cfg);
+        double seconds = NowSeconds() - start;
+        printf("%-9s %10.1f %6lld %7lld %8.3fs %9.1f %s\n", names[f], bytes / 1e6, externalSortStats.runs,
+               externalSortStats.merges, seconds, bytes / 1e6 / seconds,
+               ok && VerifyRecordFile("bench_output.tmp", &layouts[f], n) ? "ok" : "FAILED");
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+typedef struct {
+    const char *name;
+    RunGeneration runGeneration;
+    ExternalSortIo io;
+    int compressRuns;
+} SuiteStrategy;
+
+SuiteStrategy suiteStrategies[] = {
+    {"quicksort", RUNS_QUICKSORT, EXTERNAL_IO_BLOCKING, 0},
+    {"replacement", RUNS_REPLACEMENT_SELECTION, EXTERNAL_IO_BLOCKING, 0},
+    {"pipelined", RUNS_QUICKSORT, EXTERNAL_IO_THREAD, 0},
+    {"compressed", RUNS_QUICKSORT, EXTERNAL_IO_BLOCKING, 1},
+};
+
+// Cap the address space of the benchmark, a stand-in for a cgroup memory limit
+int LimitMemory(int limitMb) {
+#ifdef BENCH_RLIMIT
+    struct rlimit limit;
+    limit.rlim_cur = (rlim_t)limitMb * 1024 * 1024;
+    limit.rlim_max = limit.rlim_cur;
+    return setrlimit(RLIMIT_AS, &limit) == 0;
+#else
+    (void)limitMb;
+    return 0;
+#endif
+}
+
+/*
+ * Every input distribution under every memory budget and strategy, with
+ * the I/O and time of run generation and merging reported separately.
+ * Passes count the merge levels, the final merge included.
+ */
+void BenchSuite(int sizeMb, const int *budgetsMb, int budgetCount, int limitMb) {
+    long long n = (long long)sizeMb * 1024 * 1024 / sizeof(int);
+    double inputMb = n * 4.0 / 1e6;
+    printf("n = %lld ints (%.1f MB)", n, inputMb);
+    if (limitMb > 0) {
+        printf(", memory limit %d MB%s", limitMb, LimitMemory(limitMb) ? "" : " not supported");
+    }
+    printf("\n%-10s %6s %-11s %5s %6s %9s %9s %8s %9s %9s %8s %9s\n", "input", "memory", "strategy",
+           "runs", "passes", "p1 rd MB", "p1 wr MB", "p1 time", "p2 rd MB", "p2 wr MB", "p2 time", "MB/s");
+    for (int kind = 0; kind < 5; kind++) {
+        seed = 2463534242u;
+        WriteInput("bench_input.tmp", n, kind);
+        for (int b = 0; b < budgetCount; b++) {
+            for (size_t s = 0; s < sizeof(suiteStrategies) / sizeof(suiteStrategies[0]); s++) {
+                ExternalSortConfig cfg;
+                ExternalSortDefaultConfig(&cfg);
+                cfg.memoryBytes = (size_t)budgetsMb[b] * 1024 * 1024;
+                cfg.runGeneration = suiteStrategies[s].runGeneration;
+                cfg.io = suiteStrategies[s].io;
+                cfg.compressRuns = suiteStrategies[s].compressRuns;
+                remove("bench_output.tmp");
+                ResetExternalSortStats();
+                double start = NowSeconds();
+                int ok = ExternalSortEx("bench_input.tmp", "bench_output.tmp", &cfg);
+                double seconds = NowSeconds() - start;
+                ExternalSortStats *st = &externalSortStats;
+                printf("%-10s %3d MB %-11s %5lld %6lld %9.1f %9.1f %7.2fs %9.1f %9.1f %7.2fs %9.1f %s\n",
+                       inputNames[kind], budgetsMb[b], suiteStrategies[s].name, st->runs, st->mergePasses,
+                       st->runBytesRead / 1e6, st->runBytesWritten / 1e6, st->runSeconds,
+                       (st->bytesRead - st->runBytesRead) / 1e6, (st->bytesWritten - st->runBytesWritten) / 1e6,
+                       st->mergeSeconds, inputMb / seconds, ok && VerifyFile("bench_output.tmp", n) ? "ok" : "FAILED");
+                fflush(stdout);
+            }
+        }
+    }
+    remove("bench_input.tmp");
+    remove("bench_output.tmp");
+}
+
+// K-way merge throughput: linear scan against loser tree
+void BenchMerge(int k, int perRun) {
+    int *a = (int *)malloc(perRun * sizeof(int));
+    for (int i = 0; i < k; i++) {
+        char filename[100];
+        sprintf(filename, "bench_run_%d.tmp", i);
+        FILE *file = fopen(filename, "wb");
+        for (int j = 0; j < perRun; j++) {
+            a[j] = (int)NextRandom();
+        }
+        qsort(a, perRun, sizeof(int), CompareInt);
+        fwrite(a, sizeof(int), perRun, file);
+        fclose(file);
+    }
+    free(a);
+
+    RunFile *runs = (RunFile *)malloc(k * sizeof(RunFile));
+    long total = (long)k * perRun;
+    printf("k = %d runs of %d ints\n", k, perRun);
+
+    const char *names[] = {"KWayMerge", "LoserTreeMerge"};
+    double seconds[2];
+    for (int m = 0; m < 2; m++) {
+        FILE *output = fopen("bench_output.tmp", "wb");
+        if (!OpenRuns(runs, k) || !output) {
+            printf("Cannot open benchmark files\n");
+            return;
+        }
+        double start = NowSeconds();
+        if (m == 0) {
+            KWayMerge(runs, k, output);
+        } else {
+            LoserTreeMerge(runs, k, output);
+        }
+        fclose(output);
+        seconds[m] = NowSeconds() - start;
+        CloseRuns(runs, k);
+        printf("%-16s %8.3f s  %8.2f Mkeys/s  %s\n", names[m], seconds[m],
+               total / seconds[m] / 1e6, VerifyFile("bench_output.tmp", total) ? "ok" : "NOT SORTED");
+    }
+    printf("speedup %.2fx\n", seconds[0] / seconds[1]);
+
+    for (int i = 0; i < k; i++) {
+        char filename[100];
+        sprintf(filename, "bench_run_%d.tmp", i);
+        remove(filename);
+    }
+    remove("bench_output.tmp");
+    free(runs);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = argc > 1 ? argv[1] : "merge";
+    if (strcmp(mode, "merge") == 0) {
+        int k = argc > 2 ? atoi(argv[2]) : MAX_RUNS;
+        int perRun = argc > 3 ? atoi(argv[3]) : 100000;
+        BenchMerge(k, perRun);
+    } else if (strcmp(mode, "runs") == 0) {
+        BenchRuns(argc > 2 ? atoi(argv[2]) : 50000);
+    } else if (strcmp(mode, "budget") == 0) {
+        BenchBudget(argc > 2 ? atoi(argv[2]) : 4000000);
+    } else if (strcmp(mode, "io") == 0) {
+        BenchIo(argc > 2 ? atoi(argv[2]) : 16000000, argc > 3 ? atoi(argv[3]) : 16);
+    } else if (strcmp(mode, "threads") == 0) {
+        BenchThreads(argc > 2 ? atoi(argv[2]) : 16000000, argc > 3 ? atoi(argv[3]) : 16,
+                     argc > 4 ? atoi(argv[4]) : 8);
+    } else if (strcmp(mode, "compress") == 0) {
+        BenchCompress(argc > 2 ? atoi(argv[2]) : 16000000, argc > 3 ? atoi(argv[3]) : 4);
+    } else if (strcmp(mode, "records") == 0) {
+        BenchRecords(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? atoi(argv[3]) : 16);
+    } else if (strcmp(mode, "suite") == 0) {
+        int sizeMb = 2048, limitMb = 0, budgetCount = 0;
+        int budgetsMb[16];
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--limit-mb") == 0 && i + 1 < argc) {
+                limitMb = atoi(argv[++i]);
+            } else if (i == 2) {
+                sizeMb = atoi(argv[i]);
+            } else if (budgetCount < 16) {
+                budgetsMb[budgetCount++] = atoi(argv[i]);
+            }
+        }
+        if (budgetCount == 0) {
+            budgetsMb[budgetCount++] = 16;
+            budgetsMb[budgetCount++] = 64;
+            budgetsMb[budgetCount++] = 256;
+        }
+        BenchSuite(sizeMb, budgetsMb, budgetCount, limitMb);
+    } else {
+        printf("Usage: %s merge [k] [per_run] | runs [n] | budget [n] | io [n] [memory_mb] |\n"
+               "       threads [n] [memory_mb] [max_threads] | compress [n] [memory_mb] |\n"
+               "       records [n] [memory_mb] | suite [size_mb] [memory_mb...] [--limit-mb mb]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
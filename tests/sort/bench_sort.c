@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/sort/quick_sort.h"
+#include "include/sort/merge_sort.h"
+#include "include/sort/radix_sort.h"
+#include "include/sort/sort_ex.h"
+#include "include/sort/simd_sort.h"
+#include "include/sort/sample_sort.h"
+#include "include/sort/power_sort.h"
+#include "include/sort/top_k.h"
+
+#define CLASSIC_LIMIT 20000
+
+typedef enum {
+    INPUT_RANDOM,
+    INPUT_SORTED,
+    INPUT_REVERSE,
+    INPUT_ORGAN_PIPE,
+    INPUT_ALL_EQUAL,
+    INPUT_KINDS
+} InputKind;
+
+const char *inputNames[INPUT_KINDS] = {"random", "sorted", "reverse", "organ-pipe", "all-equal"};
+
+unsigned int seed = 2463534242u;
+
+unsigned int NextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void FillInput(int *a, int n, InputKind kind) {
+    for (int i = 0; i < n; i++) {
+        switch (kind) {
+            case INPUT_RANDOM:     a[i] = (int)NextRandom(); break;
+            case INPUT_SORTED:     a[i] = i; break;
+            case INPUT_REVERSE:    a[i] = n - i; break;
+            case INPUT_ORGAN_PIPE: a[i] = i < n / 2 ? i : n - i; break;
+            default:               a[i] = 7; break;
+        }
+    }
+}
+
+int IsSorted(int *a, int n) {
+    for (int i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) return 0;
+    }
+    return 1;
+}
+
+double NowSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Textbook quick sort (first element as pivot), kept as the baseline
+int ClassicPartition(int *a, int low, int high) {
+    int pivot = a[low];
+    while (low < high) {
+        while (low < high && a[high] >= pivot) high--;
+        a[low] = a[high];
+        while (low < high && a[low] <= pivot) low++;
+        a[high] = a[low];
+    }
+    a[low] = pivot;
+    return low;
+}
+
+void ClassicQuickSort(int *a, int low, int high) {
+    if (low < high) {
+        int pivotpos = ClassicPartition(a, low, high);
+        ClassicQuickSort(a, low, pivotpos - 1);
+        ClassicQuickSort(a, pivotpos + 1, high);
+    }
+}
+
+void BenchQuick(int n) {
+    int *a = (int *)malloc(n * sizeof(int));
+
+    printf("=== Quick Sort Benchmark (n = %d) ===\n", n);
+    printf("%-12s %14s %14s\n", "input", "classic (ms)", "introsort (ms)");
+    for (int kind = 0; kind < INPUT_KINDS; kind++) {
+        double classic = -1.0;
+        if (n <= CLASSIC_LIMIT) {
+            FillInput(a, n, kind);
+            double start = NowSeconds();
+            ClassicQuickSort(a, 0, n - 1);
+            classic = (NowSeconds() - start) * 1000;
+        }
+
+        FillInput(a, n, kind);
+        double start = NowSeconds();
+        QuickSort(a, 0, n - 1);
+        double intro = (NowSeconds() - start) * 1000;
+
+        if (!IsSorted(a, n)) {
+            printf("%-12s NOT SORTED\n", inputNames[kind]);
+            continue;
+        }
+        if (classic < 0) {
+            printf("%-12s %14s %14.2f\n", inputNames[kind], "skipped", intro);
+        } else {
+            printf("%-12s %14.2f %14.2f\n", inputNames[kind], classic, intro);
+        }
+    }
+    if (n > CLASSIC_LIMIT) {
+        printf("(classic quick sort is O(n^2) deep on ordered input; run with n <= %d to include it)\n",
+               CLASSIC_LIMIT);
+    }
+
+    free(a);
+}
+
+void BenchParallelMerge(int maxN, int maxThreads) {
+    int *a = (int *)malloc(maxN * sizeof(int));
+
+    printf("=== Parallel Merge Sort Scaling (random input) ===\n");
+    printf("%-12s %8s %12s %10s\n", "n", "threads", "time (ms)", "speedup");
+    for (int n = 1000000; n <= maxN; n *= 10) {
+        double base = 0.0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            seed = 2463534242u;
+            FillInput(a, n, INPUT_RANDOM);
+            double start = NowSeconds();
+            ParallelMergeSort(a, n, threads);
+            double ms = (NowSeconds() - start) * 1000;
+            if (threads == 1) base = ms;
+            printf("%-12d %8d %12.2f %9.2fx%s\n", n, threads, ms, base / ms,
+                   IsSorted(a, n) ? "" : "  NOT SORTED");
+        }
+        if (n > maxN / 10) break;
+    }
+
+    free(a);
+}
+
+void BenchRadix(int n) {
+    int *a = (int *)malloc(n * sizeof(int));
+
+    printf("=== Radix Sort Throughput (n = %d, random signed keys) ===\n", n);
+    printf("%-12s %12s %14s\n", "algorithm", "time (ms)", "Mkeys/sec");
+    for (int algo = 0; algo < 3; algo++) {
+        seed = 2463534242u;
+        FillInput(a, n, INPUT_RANDOM);
+        double start = NowSeconds();
+        if (algo == 0) {
+            RadixSort(a, n);
+        } else if (algo == 1) {
+            QuickSort(a, 0, n - 1);
+        } else {
+            MergeSort(a, 0, n - 1);
+        }
+        double seconds = NowSeconds() - start;
+        printf("%-12s %12.2f %14.2f%s\n",
+               algo == 0 ? "RadixSort" : (algo == 1 ? "QuickSort" : "MergeSort"),
+               seconds * 1000, n / seconds / 1e6, IsSorted(a, n) ? "" : "  NOT SORTED");
+    }
+
+    free(a);
+}
+
+void BenchAmericanFlag(int n, int maxThreads) {
+    uint64_t *keys = (uint64_t *)malloc(n * sizeof(uint64_t));
+    KeyValue64 *pairs = (KeyValue64 *)malloc(n * sizeof(KeyValue64));
+
+    printf("=== American Flag Sort (n = %d, random 64-bit keys) ===\n", n);
+    printf("%-8s %8s %12s %12s\n", "layout", "threads", "time (ms)", "Mkeys/sec");
+    for (int layout = 0; layout < 2; layout++) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            seed = 2463534242u;
+            for (int i = 0; i < n; i++) {
+                uint64_t key = ((uint64_t)NextRandom() << 32) | NextRandom();
+                keys[i] = key;
+                pairs[i].key = key;
+                pairs[i].value = i;
+            }
+            double start = NowSeconds();
+            if (layout == 0) {
+                AmericanFlagSort64(keys, n, threads);
+            } else {
+                AmericanFlagSortPairs(pairs, n, threads);
+            }
+            double seconds = NowSeconds() - start;
+
+            int sorted = 1;
+            for (int i = 1; i < n; i++) {
+                if (layout == 0 ? keys[i - 1] > keys[i] : pairs[i - 1].key > pairs[i].key) {
+                    sorted = 0;
+                    break;
+                }
+            }
+            printf("%-8s %8d %12.2f %12.2f%s\n", layout == 0 ? "keys" : "pairs", threads,
+                   seconds * 1000, n / seconds / 1e6, sorted ? "" : "  NOT SORTED");
+        }
+    }
+
+    free(keys);
+    free(pairs);
+}
+
+typedef struct {
+    int key;
+    int id;
+    double payload;
+} BenchRecord;
+
+int CompareBenchRecord(const void *x, const void *y) {
+    int a = ((const BenchRecord *)x)->key, b = ((const BenchRecord *)y)->key;
+    return (a > b) - (a < b);
+}
+
+#define BENCH_RECORD_LESS(x, y) ((x).key < (y).key)
+SORT_EX_DEFINE(SortBenchRecords, BenchRecord, BENCH_RECORD_LESS)
+
+void BenchGeneric(int n) {
+    BenchRecord *records = (BenchRecord *)malloc(n * sizeof(BenchRecord));
+    const char *names[] = {"qsort", "SortEx quick", "SortEx merge", "SortEx heap", "SORT_EX_DEFINE"};
+
+    printf("=== Generic Record Sort (n = %d, 16-byte records) ===\n", n);
+    printf("%-16s %12s %12s\n", "algorithm", "time (ms)", "vs qsort");
+    double base = 0.0;
+    for (int algo = 0; algo < 5; algo++) {
+        seed = 2463534242u;
+        for (int i = 0; i < n; i++) {
+            records[i].key = (int)NextRandom();
+            records[i].id = i;
+            records[i].payload = i * 0.5;
+        }
+        double start = NowSeconds();
+        switch (algo) {
+            case 0: qsort(records, n, sizeof(BenchRecord), CompareBenchRecord); break;
+            case 1: SortEx(records, n, sizeof(BenchRecord), CompareBenchRecord, SORT_QUICK); break;
+            case 2: SortEx(records, n, sizeof(BenchRecord), CompareBenchRecord, SORT_MERGE); break;
+            case 3: SortEx(records, n, sizeof(BenchRecord), CompareBenchRecord, SORT_HEAP); break;
+            default: SortBenchRecords(records, n); break;
+        }
+        double ms = (NowSeconds() - start) * 1000;
+        if (algo == 0) base = ms;
+
+        int sorted = 1;
+        for (int i = 1; i < n; i++) {
+            if (records[i - 1].key > records[i].key) {
+                sorted = 0;
+                break;
+            }
+        }
+        printf("%-16s %12.2f %11.2fx%s\n", names[algo], ms, base / ms, sorted ? "" : "  NOT SORTED");
+    }
+
+    free(records);
+}
+
+void BenchSimd(int repeat) {
+    int sizes[] = {1024, 8192, 65536};
+    int *a = (int *)malloc(65536 * sizeof(int));
+
+    printf("=== SIMD Sort Kernels (random input, AVX2 %s) ===\n",
+           SimdSortAvailable() ? "available" : "not available");
+    printf("%-8s %-10s %12s %12s %10s\n", "n", "algorithm", "scalar (ms)", "simd (ms)", "speedup");
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        for (int algo = 0; algo < 2; algo++) {
+            double ms[2];
+            int sorted = 1;
+            for (int simd = 0; simd < 2; simd++) {
+                SimdSortEnable(simd);
+                seed = 2463534242u;
+                double total = 0.0;
+                for (int r = 0; r < repeat; r++) {
+                    FillInput(a, n, INPUT_RANDOM);
+                    double start = NowSeconds();
+                    if (algo == 0) {
+                        QuickSort(a, 0, n - 1);
+                    } else {
+                        MergeSort(a, 0, n - 1);
+                    }
+                    total += NowSeconds() - start;
+                    sorted = sorted && IsSorted(a, n);
+                }
+                ms[simd] = total * 1000;
+            }
+            printf("%-8d %-10s %12.2f %12.2f %9.2fx%s\n", n, algo == 0 ? "QuickSort" : "MergeSort",
+                   ms[0], ms[1], ms[0] / ms[1], sorted ? "" : "  NOT SORTED");
+        }
+    }
+    SimdSortEnable(1);
+
+    free(a);
+}
+
+void BenchSample(int n, int maxThreads) {
+    int *a = (int *)malloc(n * sizeof(int));
+    const int kinds[] = {INPUT_RANDOM, INPUT_ALL_EQUAL};
+
+    printf("=== Sample Sort Scaling (n = %d) ===\n", n);
+    for (int k = 0; k < 2; k++) {
+        seed = 2463534242u;
+        FillInput(a, n, kinds[k]);
+        double start = NowSeconds();
+        QuickSort(a, 0, n - 1);
+        double base = (NowSeconds() - start) * 1000;
+        printf("\n%s input, QuickSort baseline: %.2f ms\n", inputNames[kinds[k]], base);
+
+        printf("%8s %12s %10s %16s\n", "threads", "time (ms)", "speedup", "extra bytes/elem");
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            seed = 2463534242u;
+            FillInput(a, n, kinds[k]);
+            start = NowSeconds();
+            SampleSort(a, n, threads);
+            double ms = (NowSeconds() - start) * 1000;
+            printf("%8d %12.2f %9.2fx %16.2f%s\n", threads, ms, base / ms,
+                   (double)SampleSortMemory(n, threads) / n, IsSorted(a, n) ? "" : "  NOT SORTED");
+        }
+    }
+
+    free(a);
+}
+
+// Partially ordered inputs: k-sorted, sorted with an appended tail, sorted batches
+void FillPresorted(int *a, int n, int kind) {
+    for (int i = 0; i < n; i++) {
+        a[i] = i;
+    }
+    if (kind == 0) {
+        for (int i = 0; i + 16 < n; i++) {
+            int j = i + NextRandom() % 16;
+            int temp = a[i];
+            a[i] = a[j];
+            a[j] = temp;
+        }
+    } else if (kind == 1) {
+        for (int i = n - n / 100; i < n; i++) {
+            a[i] = NextRandom() % n;
+        }
+    } else {
+        int batch = n / 16;
+        for (int i = 0; i < n; i++) {
+            a[i] = (i % batch) * 16 + i / batch;
+        }
+    }
+}
+
+void BenchAdaptive(int maxN) {
+    const char *kinds[] = {"k-sorted", "append-1%", "16-batches"};
+    int *a = (int *)malloc(maxN * sizeof(int));
+
+    printf("=== Adaptive Sort on Partially Ordered Input (ns/element) ===\n");
+    printf("%-12s %-10s %12s %12s %12s\n", "input", "n", "PowerSort", "MergeSort", "QuickSort");
+    for (int kind = 0; kind < 3; kind++) {
+        for (int n = maxN / 8; n <= maxN; n *= 2) {
+            double ns[3];
+            int sorted = 1;
+            for (int algo = 0; algo < 3; algo++) {
+                seed = 2463534242u;
+                FillPresorted(a, n, kind);
+                double start = NowSeconds();
+                if (algo == 0) {
+                    PowerSort(a, n);
+                } else if (algo == 1) {
+                    MergeSort(a, 0, n - 1);
+                } else {
+                    QuickSort(a, 0, n - 1);
+                }
+                ns[algo] = (NowSeconds() - start) * 1e9 / n;
+                sorted = sorted && IsSorted(a, n);
+            }
+            printf("%-12s %-10d %12.2f %12.2f %12.2f%s\n", kinds[kind], n, ns[0], ns[1], ns[2],
+                   sorted ? "" : "  NOT SORTED");
+        }
+    }
+
+    free(a);
+}
+
+// a[k] holds the k-th smallest of ref and nothing before it is larger, nothing after smaller
+int IsNthElement(const int *a, const int *ref, int n, int k) {
+    if (a[k] != ref[k]) return 0;
+    for (int i = 0; i < n; i++) {
+        if (i < k ? a[i] > a[k] : a[i] < a[k]) return 0;
+    }
+    return 1;
+}
+
+void BenchSelect(int n, int k) {
+    int *a = (int *)malloc(n * sizeof(int));
+    int *ref = (int *)malloc(n * sizeof(int));
+    int *out = (int *)malloc(k * sizeof(int));
+    const char *names[] = {"QuickSort (full)", "PartialSort", "NthElement (k)", "NthElement (n/2)", "TopK stream"};
+
+    printf("=== Selection (n = %d, k = %d) ===\n", n, k);
+    printf("%-18s %-8s %12s\n", "algorithm", "input", "time (ms)");
+    for (int kind = INPUT_RANDOM; kind <= INPUT_ORGAN_PIPE; kind++) {
+        seed = 2463534242u;
+        FillInput(ref, n, kind);
+        QuickSort(ref, 0, n - 1);
+        for (int algo = 0; algo < 5; algo++) {
+            seed = 2463534242u;
+            FillInput(a, n, kind);
+            double start = NowSeconds();
+            int ok = 1;
+            if (algo == 0) {
+                QuickSort(a, 0, n - 1);
+            } else if (algo == 1) {
+                PartialSort(a, n, k);
+            } else if (algo == 2) {
+                NthElement(a, n, k - 1);
+            } else if (algo == 3) {
+                NthElement(a, n, n / 2);
+            } else {
+                TopK T;
+                InitTopK(&T, k);
+                for (int i = 0; i < n; i++) {
+                    TopKPush(&T, a[i]);
+                }
+                ok = TopKResult(&T, out) == k && memcmp(out, ref, k * sizeof(int)) == 0;
+                DestroyTopK(&T);
+            }
+            double ms = (NowSeconds() - start) * 1000;
+            if (algo == 0) {
+                ok = memcmp(a, ref, n * sizeof(int)) == 0;
+            } else if (algo == 1) {
+                ok = memcmp(a, ref, k * sizeof(int)) == 0;
+            } else if (algo == 2) {
+                ok = IsNthElement(a, ref, n, k - 1);
+            } else if (algo == 3) {
+                ok = IsNthElement(a, ref, n, n / 2);
+            }
+            printf("%-18s %-8s %12.2f%s\n", names[algo], inputNames[kind], ms, ok ? "" : "  WRONG");
+        }
+    }
+
+    free(out);
+    free(ref);
+    free(a);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = argc > 1 ? argv[1] : "quick";
+
+    if (strcmp(mode, "quick") == 0) {
+        BenchQuick(argc > 2 ? atoi(argv[2]) : 1000000);
+    } else if (strcmp(mode, "merge") == 0) {
+        BenchParallelMerge(argc > 2 ? atoi(argv[2]) : 10000000,
+                           argc > 3 ? atoi(argv[3]) : 8);
+    } else if (strcmp(mode, "radix") == 0) {
+        BenchRadix(argc > 2 ? atoi(argv[2]) : 10000000);
+    } else if (strcmp(mode, "msd") == 0) {
+        BenchAmericanFlag(argc > 2 ? atoi(argv[2]) : 10000000,
+                          argc > 3 ? atoi(argv[3]) : 8);
+    } else if (strcmp(mode, "generic") == 0) {
+        BenchGeneric(argc > 2 ? atoi(argv[2]) : 1000000);
+    } else if (strcmp(mode, "simd") == 0) {
+        BenchSimd(argc > 2 ? atoi(argv[2]) : 200);
+    } else if (strcmp(mode, "sample") == 0) {
+        BenchSample(argc > 2 ? atoi(argv[2]) : 10000000,
+                    argc > 3 ? atoi(argv[3]) : 64);
+    } else if (strcmp(mode, "adaptive") == 0) {
+        BenchAdaptive(argc > 2 ? atoi(argv[2]) : 8000000);
+    } else if (strcmp(mode, "select") == 0) {
+        BenchSelect(argc > 2 ? atoi(argv[2]) : 10000000,
+                    argc > 3 ? atoi(argv[3]) : 1000);
+    } else {
+        printf("Usage: bench_sort [quick [n] | merge [max_n] [max_threads] | radix [n] |"
+               " msd [n] [max_threads] | generic [n] | simd [repeat] |"
+               " sample [n] [max_threads] | adaptive [max_n] | select [n] [k]]\n");
+        return 1;
+    }
+    return 0;
+}
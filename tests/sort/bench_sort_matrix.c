@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/sort/bubble_sort.h"
+#include "include/sort/selection_sort.h"
+#include "include/sort/insert_sort.h"
+#include "include/sort/shell_sort.h"
+#include "include/sort/quick_sort.h"
+#include "include/sort/heap_sort.h"
+#include "include/sort/merge_sort.h"
+#include "include/sort/radix_sort.h"
+#include "include/sort/sort_stats.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Sort benchmark matrix
+ *
+ * Runs every int sort over a range of sizes and input distributions and
+ * prints one CSV row (or JSON object) per combination. Build with
+ * -DSORT_STATS to fill in the compare/move columns; hardware counters
+ * come from perf_event_open on Linux and are left empty elsewhere.
+ *
+ * Usage: bench_sort_matrix [--json] [max_n]
+ */
+
+#define QUADRATIC_LIMIT 20000
+#define MIN_ELEMENTS_PER_CELL 200000
+
+typedef struct {
+    const char *name;
+    void (*sort)(int *a, int n);
+    int quadratic;
+} SortEntry;
+
+void QuickSortN(int *a, int n) {
+    QuickSort(a, 0, n - 1);
+}
+
+void MergeSortN(int *a, int n) {
+    MergeSort(a, 0, n - 1);
+}
+
+SortEntry sorts[] = {
+    {"BubbleSort", BubbleSort, 1},
+    {"SelectionSort", SelectionSort, 1},
+    {"InsertSort", InsertSort, 1},
+    {"BinaryInsertSort", BinaryInsertSort, 1},
+    {"ShellSort", ShellSort, 0},
+    {"QuickSort", QuickSortN, 0},
+    {"HeapSort", HeapSort, 0},
+    {"MergeSort", MergeSortN, 0},
+    {"RadixSort", RadixSort, 0},
+};
+
+const char *inputNames[] = {"random", "sorted", "reverse", "organ-pipe", "all-equal", "few-unique"};
+
+unsigned int seed = 2463534242u;
+
+unsigned int NextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void FillInput(int *a, int n, int kind) {
+    for (int i = 0; i < n; i++) {
+        switch (kind) {
+            case 0:  a[i] = (int)NextRandom(); break;
+            case 1:  a[i] = i; break;
+            case 2:  a[i] = n - i; break;
+            case 3:  a[i] = i < n / 2 ? i : n - i; break;
+            case 4:  a[i] = 7; break;
+            default: a[i] = NextRandom() % 16; break;
+        }
+    }
+}
+
+int IsSorted(int *a, int n) {
+    for (int i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) return 0;
+    }
+    return 1;
+}
+
+double NowSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Cache misses and branch mispredictions of this thread, user space only
+typedef struct {
+    int fd[2];
+    unsigned long long value[2];
+} PerfCounters;
+
+int OpenPerfCounters(PerfCounters *p) {
+#ifdef __linux__
+    unsigned long long config[2] = {PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < 2; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        p->fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (p->fd[i] < 0) {
+            if (i == 1) close(p->fd[0]);
+            return 0;
+        }
+    }
+    return 1;
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+void StartPerfCounters(PerfCounters *p) {
+#ifdef __linux__
+    for (int i = 0; i < 2; i++) {
+        ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)p;
+#endif
+}
+
+void StopPerfCounters(PerfCounters *p) {
+#ifdef __linux__
+    for (int i = 0; i < 2; i++) {
+        ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(p->fd[i], &p->value[i], sizeof(p->value[i])) != sizeof(p->value[i])) {
+            p->value[i] = 0;
+        }
+    }
+#else
+    (void)p;
+#endif
+}
+
+void ClosePerfCounters(PerfCounters *p) {
+#ifdef __linux__
+    close(p->fd[0]);
+    close(p->fd[1]);
+#else
+    (void)p;
+#endif
+}
+
+// Print an optional counter as a CSV field or JSON value
+void PrintCounter(int json, int valid, double value) {
+    if (valid) {
+        printf("%.0f", value);
+    } else if (json) {
+        printf("null");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int json = 0;
+    int maxN = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else {
+            maxN = atoi(argv[i]);
+        }
+    }
+#ifdef SORT_STATS
+    int haveStats = 1;
+#else
+    int haveStats = 0;
+#endif
+
+    PerfCounters perf;
+    int havePerf = OpenPerfCounters(&perf);
+    int *a = (int *)malloc(maxN * sizeof(int));
+    int first = 1;
+
+    if (json) {
+        printf("[\n");
+    } else {
+        printf("algorithm,input,n,ns_per_element,compares,moves,cache_misses,branch_misses\n");
+    }
+    for (size_t s = 0; s < sizeof(sorts) / sizeof(sorts[0]); s++) {
+        for (int kind = 0; kind < 6; kind++) {
+            for (int n = 1000; n <= maxN; n *= 10) {
+                if (sorts[s].quadratic && n > QUADRATIC_LIMIT) break;
+
+                int work = sorts[s].quadratic ? MIN_ELEMENTS_PER_CELL / 100 : MIN_ELEMENTS_PER_CELL;
+                int repeat = work / n > 1 ? work / n : 1;
+                double seconds = 0.0;
+                double misses[2] = {0.0, 0.0};
+                int sorted = 1;
+                ResetSortStats();
+                seed = 2463534242u;
+                for (int r = 0; r < repeat; r++) {
+                    FillInput(a, n, kind);
+                    if (havePerf) StartPerfCounters(&perf);
+                    double start = NowSeconds();
+                    sorts[s].sort(a, n);
+                    seconds += NowSeconds() - start;
+                    if (havePerf) {
+                        StopPerfCounters(&perf);
+                        misses[0] += perf.value[0];
+                        misses[1] += perf.value[1];
+                    }
+                    sorted = sorted && IsSorted(a, n);
+                }
+                if (!sorted) {
+                    fprintf(stderr, "%s did not sort %s input of %d elements\n",
+                            sorts[s].name, inputNames[kind], n);
+                }
+
+                double nsPerElement = seconds * 1e9 / repeat / n;
+                if (json) {
+                    printf("%s  {\"algorithm\": \"%s\", \"input\": \"%s\", \"n\": %d, "
+                           "\"ns_per_element\": %.3f, \"compares\": ",
+                           first ? "" : ",\n", sorts[s].name, inputNames[kind], n, nsPerElement);
+                    PrintCounter(json, haveStats, (double)sortStats.compares / repeat);
+                    printf(", \"moves\": ");
+                    PrintCounter(json, haveStats, (double)sortStats.moves / repeat);
+                    printf(", \"cache_misses\": ");
+                    PrintCounter(json, havePerf, misses[0] / repeat);
+                    printf(", \"branch_misses\": ");
+                    PrintCounter(json, havePerf, misses[1] / repeat);
+                    printf("}");
+                } else {
+                    printf("%s,%s,%d,%.3f,", sorts[s].name, inputNames[kind], n, nsPerElement);
+                    PrintCounter(json, haveStats, (double)sortStats.compares / repeat);
+                    printf(",");
+                    PrintCounter(json, haveStats, (double)sortStats.moves / repeat);
+                    printf(",");
+                    PrintCounter(json, havePerf, misses[0] / repeat);
+                    printf(",");
+                    PrintCounter(json, havePerf, misses[1] / repeat);
+                    printf("\n");
+                }
+                first = 0;
+                fflush(stdout);
+            }
+        }
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+
+    if (havePerf) ClosePerfCounters(&perf);
+    free(a);
+    return 0;
+}
@@ -1,10 +1,20 @@
 #include "../../include/sort/external_sort.h"
+#include "../../include/sort/run_codec.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define MakeDir(path) _mkdir(path)
+#else
+#define MakeDir(path) mkdir(path, 0700)
+#endif
 
 // 创建测试数据文件
 void CreateTestFile(const char *filename, int size) {
-    FILE *file = fopen(filename, "w");
+    FILE *file = fopen(filename, "wb");
     if (!file) {
         printf("Cannot create test file\n");
         return;
@@ -22,7 +32,7 @@ void CreateTestFile(const char *filename, int size) {
 
 // 验证排序结果
 int VerifySorted(const char *filename) {
-    FILE *file = fopen(filename, "r");
+    FILE *file = fopen(filename, "rb");
     if (!file) {
         return 0;
     }
@@ -44,6 +54,145 @@ int VerifySorted(const char *filename) {
     return isSorted;
 }
 
+// 写入定长记录：4 字节头、4 字节大端键、8 字节载荷（键的副本）
+void CreateRecordFile(const char *filename, int count) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        unsigned int key = (unsigned int)rand() * 7919u + (unsigned int)i;
+        unsigned char record[16];
+        for (int b = 0; b < 4; b++) {
+            record[b] = (unsigned char)i;
+            record[4 + b] = (unsigned char)(key >> (24 - 8 * b));
+            record[8 + b] = record[4 + b];
+            record[12 + b] = 0;
+        }
+        fwrite(record, 1, sizeof(record), file);
+    }
+    fclose(file);
+}
+
+// 检查记录按键排序且载荷跟随键
+int VerifyRecords(const char *filename, int count) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return 0;
+    }
+    unsigned char prev[16], curr[16];
+    int n = 0, ok = 1;
+    while (fread(curr, 1, sizeof(curr), file) == sizeof(curr)) {
+        if ((n > 0 && memcmp(prev + 4, curr + 4, 4) > 0) || memcmp(curr + 4, curr + 8, 4) != 0) {
+            ok = 0;
+        }
+        memcpy(prev, curr, sizeof(curr));
+        n++;
+    }
+    fclose(file);
+    return ok && n == count;
+}
+
+// 检查文本行按字节序排列
+int VerifyLines(const char *filename, int count) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return 0;
+    }
+    char prev[64] = "", curr[64];
+    int n = 0, ok = 1;
+    while (fgets(curr, sizeof(curr), file)) {
+        if (strcmp(prev, curr) > 0) {
+            ok = 0;
+        }
+        strcpy(prev, curr);
+        n++;
+    }
+    fclose(file);
+    return ok && n == count;
+}
+
+int CompareInts(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+// 模拟中断的作业：作业目录里只有排好序的第一个归并段和记录它的清单，
+// 清单首行按大小、设备、inode 和修改时间标识输入文件
+int CreateInterruptedJob(const char *jobDir, const char *inputFile, int count) {
+    char path[256];
+    struct stat st;
+    int *values = (int *)malloc(count * sizeof(int));
+    FILE *input = fopen(inputFile, "rb");
+    if (!values || !input || stat(inputFile, &st) != 0 ||
+        fread(values, sizeof(int), count, input) != (size_t)count) {
+        if (input) fclose(input);
+        free(values);
+        return 0;
+    }
+    fclose(input);
+    qsort(values, count, sizeof(int), CompareInts);
+
+    MakeDir(jobDir);
+    sprintf(path, "%s/run_0.tmp", jobDir);
+    FILE *run = fopen(path, "wb");
+    sprintf(path, "%s/manifest.txt", jobDir);
+    FILE *manifest = fopen(path, "w");
+    if (run) {
+        fwrite(values, sizeof(int), count, run);
+        fclose(run);
+    }
+    if (manifest) {
+        fprintf(manifest, "extsort %lld 0 %lld %lld %lld\nrun 0 %ld\n", (long long)st.st_size, (long long)st.st_dev,
+                (long long)st.st_ino, (long long)st.st_mtime, (long)(count * sizeof(int)));
+        fclose(manifest);
+    }
+    free(values);
+    return run && manifest;
+}
+
+// 把已排序文件的 [from, from + bytes) 写成归并段 dir/run_<id>.tmp
+int WriteRunSlice(const char *dir, int id, const char *sortedFile, long from, long bytes) {
+    char path[256];
+    sprintf(path, "%s/run_%d.tmp", dir, id);
+    FILE *in = fopen(sortedFile, "rb");
+    FILE *out = fopen(path, "wb");
+    char *data = (char *)malloc(bytes > 0 ? bytes : 1);
+    int ok = in && out && data && fseek(in, from, SEEK_SET) == 0 &&
+             fread(data, 1, bytes, in) == (size_t)bytes && fwrite(data, 1, bytes, out) == (size_t)bytes;
+    if (in) fclose(in);
+    if (out) fclose(out);
+    free(data);
+    return ok;
+}
+
+// 两个文件内容是否相同
+int FilesEqual(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int equal = fa && fb;
+    while (equal) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        equal = ca == cb;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return equal;
+}
+
+// 文件大小（字节）
+long FileSize(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
 int main() {
     printf("=== External Sort Tests ===\n\n");
 
@@ -85,7 +234,7 @@ int main() {
     CreateTestFile("input_sorted.txt", 100);
 
     // 手动创建已排序文件
-    FILE *file = fopen("input_sorted.txt", "w");
+    FILE *file = fopen("input_sorted.txt", "wb");
     if (file) {
         for (int i = 0; i < 100; i++) {
             int num = i * 10;
@@ -102,6 +251,182 @@ int main() {
         printf("Already sorted: FAILED ✗\n");
     }
 
+    // 测试5：内存预算 + 多趟归并
+    printf("\nTest 5: ExternalSortEx with a 256 KB budget and fan-in 4 (300000 numbers)\n");
+    CreateTestFile("input_budget.txt", 300000);
+    ExternalSortConfig cfg;
+    ExternalSortDefaultConfig(&cfg);
+    cfg.memoryBytes = 256 * 1024;
+    cfg.maxFanIn = 4;
+    ResetExternalSortStats();
+
+    if (ExternalSortEx("input_budget.txt", "output_budget.txt", &cfg) && VerifySorted("output_budget.txt")) {
+        printf("Budget sort: %lld runs, %lld merges: VERIFIED ✓\n",
+               externalSortStats.runs, externalSortStats.merges);
+    } else {
+        printf("Budget sort: FAILED ✗\n");
+    }
+
+    // 测试6：流水线 I/O（后台线程与 io_uring）
+    printf("\nTest 6: Pipelined I/O (300000 numbers)\n");
+    cfg.io = EXTERNAL_IO_THREAD;
+    int threadOk = ExternalSortEx("input_budget.txt", "output_thread.txt", &cfg) && VerifySorted("output_thread.txt");
+    cfg.io = EXTERNAL_IO_URING;
+    cfg.runGeneration = RUNS_REPLACEMENT_SELECTION;
+    int uringOk = ExternalSortEx("input_budget.txt", "output_uring.txt", &cfg) && VerifySorted("output_uring.txt");
+    threadOk = threadOk && FileSize("output_thread.txt") == FileSize("input_budget.txt");
+    uringOk = uringOk && FileSize("output_uring.txt") == FileSize("input_budget.txt");
+
+    if (threadOk && uringOk) {
+        printf("Pipelined I/O: VERIFIED ✓\n");
+    } else {
+        printf("Pipelined I/O: FAILED ✗\n");
+    }
+
+    // 测试7：多线程生成归并段与按键分区并行归并
+    printf("\nTest 7: 4 threads (300000 numbers)\n");
+    cfg.io = EXTERNAL_IO_BLOCKING;
+    cfg.runGeneration = RUNS_QUICKSORT;
+    cfg.threads = 4;
+
+    if (ExternalSortEx("input_budget.txt", "output_threads.txt", &cfg) && VerifySorted("output_threads.txt") &&
+        FileSize("output_threads.txt") == FileSize("input_budget.txt")) {
+        printf("Parallel sort: VERIFIED ✓\n");
+    } else {
+        printf("Parallel sort: FAILED ✗\n");
+    }
+
+    // 测试8：内存映射模式（映射输入、归并段与输出文件）
+    printf("\nTest 8: Memory-mapped I/O (300000 numbers)\n");
+    cfg.io = EXTERNAL_IO_MMAP;
+    cfg.threads = 1;
+
+    if (ExternalSortEx("input_budget.txt", "output_mmap.txt", &cfg) && VerifySorted("output_mmap.txt") &&
+        FileSize("output_mmap.txt") == FileSize("input_budget.txt")) {
+        printf("Mapped sort: VERIFIED ✓\n");
+    } else {
+        printf("Mapped sort: FAILED ✗\n");
+    }
+
+    // 测试9：压缩归并段（差分编码），含极值块的编解码往返
+    printf("\nTest 9: Compressed runs (300000 numbers)\n");
+    int block[RUN_CODEC_BLOCK], decoded[RUN_CODEC_BLOCK];
+    unsigned char encoded[RUN_CODEC_MAX_BYTES];
+    for (int i = 0; i < RUN_CODEC_BLOCK; i++) {
+        block[i] = i % 3 == 0 ? INT_MIN : (i % 3 == 1 ? INT_MAX : i - 64);
+    }
+    int bytes = RunCodecEncodeBlock(block, RUN_CODEC_BLOCK, encoded);
+    int codecOk = RunCodecBlockBytes(encoded) == bytes &&
+                  RunCodecDecodeBlock(encoded, decoded) == RUN_CODEC_BLOCK &&
+                  memcmp(block, decoded, sizeof(block)) == 0;
+    // 损坏的块头（位宽超过32）必须被拒绝
+    encoded[2] = 33;
+    codecOk = codecOk && RunCodecBlockBytes(encoded) < 0 && RunCodecDecodeBlock(encoded, decoded) == 0;
+
+    cfg.io = EXTERNAL_IO_BLOCKING;
+    cfg.compressRuns = 1;
+    ResetExternalSortStats();
+    if (codecOk && ExternalSortEx("input_budget.txt", "output_compressed.txt", &cfg) &&
+        VerifySorted("output_compressed.txt") &&
+        FileSize("output_compressed.txt") == FileSize("input_budget.txt") &&
+        externalSortStats.encodedBytes < externalSortStats.encodedValues * 4) {
+        printf("Compressed runs: %.2fx smaller: VERIFIED ✓\n",
+               externalSortStats.encodedValues * 4.0 / externalSortStats.encodedBytes);
+    } else {
+        printf("Compressed runs: FAILED ✗\n");
+    }
+
+    // 测试10：定长记录与文本行的外部排序
+    printf("\nTest 10: Records and lines (50000 each)\n");
+    cfg.compressRuns = 0;
+    RecordLayout layout;
+    layout.format = RECORDS_FIXED;
+    layout.recordSize = 16;
+    layout.keyOffset = 4;
+    layout.keyLength = 4;
+    CreateRecordFile("input_records.bin", 50000);
+    int recordsOk = ExternalSortRecords("input_records.bin", "output_records.bin", &layout, &cfg) &&
+                    VerifyRecords("output_records.bin", 50000);
+
+    FILE *lines = fopen("input_lines.txt", "wb");
+    if (lines) {
+        for (int i = 0; i < 50000; i++) {
+            fprintf(lines, "key%d-%d\n", rand() % 100000, i);
+        }
+        fclose(lines);
+    }
+    layout.format = RECORDS_LINES;
+    layout.keyOffset = 0;
+    layout.keyLength = 0;
+    int linesOk = ExternalSortRecords("input_lines.txt", "output_lines.txt", &layout, &cfg) &&
+                  VerifyLines("output_lines.txt", 50000) &&
+                  FileSize("output_lines.txt") == FileSize("input_lines.txt");
+
+    if (recordsOk && linesOk) {
+        printf("Record sort: VERIFIED ✓\n");
+    } else {
+        printf("Record sort: FAILED ✗\n");
+    }
+
+    // 测试11：作业目录、清单续跑与归并中删除已消费的归并段
+    printf("\nTest 11: Resume from a job manifest (300000 numbers)\n");
+    cfg.jobDir = "resume_job";
+    ResetExternalSortStats();
+    int freshOk = ExternalSortEx("input_budget.txt", "output_resume.txt", &cfg) && VerifySorted("output_resume.txt");
+    long long freshRead = externalSortStats.bytesRead;
+
+    int resumeOk = CreateInterruptedJob("resume_job", "input_budget.txt", 100000);
+    cfg.dropConsumedRuns = 1;
+    ResetExternalSortStats();
+    resumeOk = resumeOk && ExternalSortEx("input_budget.txt", "output_resume.txt", &cfg) &&
+               VerifySorted("output_resume.txt") &&
+               FileSize("output_resume.txt") == FileSize("input_budget.txt") &&
+               externalSortStats.bytesRead < freshRead &&
+               FileSize("resume_job/manifest.txt") < 0;
+
+    // 同样大小的另一个输入不能接着用旧作业的归并段
+    FILE *other = fopen("input_other.txt", "wb");
+    if (other) {
+        for (long i = 0; i < FileSize("input_budget.txt") / (long)sizeof(int); i++) {
+            int value = (int)(i * 7919 % 100003);
+            fwrite(&value, sizeof(int), 1, other);
+        }
+        fclose(other);
+    }
+    int staleOk = CreateInterruptedJob("resume_job", "input_budget.txt", 100000) &&
+                  ExternalSortEx("input_other.txt", "output_other_job.txt", &cfg);
+    cfg.jobDir = NULL;
+    staleOk = staleOk && ExternalSortEx("input_other.txt", "output_other.txt", &cfg) &&
+              FilesEqual("output_other_job.txt", "output_other.txt");
+    cfg.dropConsumedRuns = 0;
+
+    if (freshOk && resumeOk && staleOk) {
+        printf("Resumed sort: VERIFIED ✓\n");
+    } else {
+        printf("Resumed sort: FAILED ✗\n");
+    }
+
+    // 测试12：归并段末尾的残缺记录必须让归并失败，而不是少输出记录
+    printf("\nTest 12: Truncated record run (2 x 20000 records)\n");
+    layout.format = RECORDS_FIXED;
+    layout.keyOffset = 4;
+    layout.keyLength = 4;
+    MakeDir("record_runs");
+    int runsOk = WriteRunSlice("record_runs", 0, "output_records.bin", 0, 20000 * 16) &&
+                 WriteRunSlice("record_runs", 1, "output_records.bin", 20000 * 16, 20000 * 16);
+    int wholeOk = runsOk && MergeRecordRuns("record_runs", 2, "output_record_runs.bin", &layout) &&
+                  VerifyRecords("output_record_runs.bin", 40000);
+    // 第二个归并段少了最后一条记录的 5 个字节
+    runsOk = runsOk && WriteRunSlice("record_runs", 1, "output_records.bin", 20000 * 16, 20000 * 16 - 5);
+    int truncatedFails = runsOk && !MergeRecordRuns("record_runs", 2, "output_record_runs.bin", &layout) &&
+                         FileSize("output_record_runs.bin") < 0;
+
+    if (wholeOk && truncatedFails) {
+        printf("Truncated run rejected: VERIFIED ✓\n");
+    } else {
+        printf("Truncated run rejected: FAILED ✗\n");
+    }
+
     printf("\n=== All Tests Completed ===\n");
     return 0;
 }
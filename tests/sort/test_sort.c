@@ -8,6 +8,11 @@
 #include "include/sort/heap_sort.h"
 #include "include/sort/merge_sort.h"
 #include "include/sort/radix_sort.h"
+#include "include/sort/sort_ex.h"
+#include "include/sort/simd_sort.h"
+#include "include/sort/sample_sort.h"
+#include "include/sort/power_sort.h"
+#include "include/sort/top_k.h"
 
 void PrintArray(int *a, int n) {
     for (int i = 0; i < n; i++) {
@@ -22,6 +27,16 @@ void CopyArray(int *src, int *dest, int n) {
     }
 }
 
+typedef struct {
+    int key;
+    char name[12];
+} Record;
+
+int CompareRecord(const void *x, const void *y) {
+    int a = ((const Record *)x)->key, b = ((const Record *)y)->key;
+    return (a > b) - (a < b);
+}
+
 int main() {
     int arr[] = {49, 38, 65, 97, 76, 13, 27, 49, 55, 4};
     int n = 10;
@@ -79,11 +94,94 @@ int main() {
     printf("After sort: ");
     PrintArray(temp, n);
 
+    printf("\n--- Parallel Merge Sort (4 threads) ---\n");
+    CopyArray(arr, temp, n);
+    ParallelMergeSort(temp, n, 4);
+    printf("After sort: ");
+    PrintArray(temp, n);
+
+    printf("\n--- Sorting Network (AVX2 %s) ---\n", SimdSortAvailable() ? "on" : "off");
+    CopyArray(arr, temp, n);
+    SortingNetwork(temp, n);
+    printf("After sort: ");
+    PrintArray(temp, n);
+
+    printf("\n--- Sample Sort (4 threads) ---\n");
+    CopyArray(arr, temp, n);
+    SampleSort(temp, n, 4);
+    printf("After sort: ");
+    PrintArray(temp, n);
+
+    printf("\n--- Power Sort ---\n");
+    CopyArray(arr, temp, n);
+    PowerSort(temp, n);
+    printf("After sort: ");
+    PrintArray(temp, n);
+
+    printf("\n--- Selection ---\n");
+    CopyArray(arr, temp, n);
+    NthElement(temp, n, n / 2);
+    printf("Median (NthElement): %d\n", temp[n / 2]);
+    CopyArray(arr, temp, n);
+    PartialSort(temp, n, 3);
+    printf("Smallest 3 (PartialSort): %d %d %d\n", temp[0], temp[1], temp[2]);
+    TopK T;
+    InitTopK(&T, 3);
+    for (int i = 0; i < n; i++) {
+        TopKPush(&T, arr[i]);
+    }
+    TopKResult(&T, temp);
+    printf("Smallest 3 (TopK stream): %d %d %d\n", temp[0], temp[1], temp[2]);
+    DestroyTopK(&T);
+    InitTopK(&T, 0);
+    for (int i = 0; i < n; i++) {
+        TopKPush(&T, arr[i]);
+    }
+    printf("Smallest 0 (TopK stream): %d kept\n", TopKResult(&T, temp));
+    DestroyTopK(&T);
+
     printf("\n--- Radix Sort ---\n");
     CopyArray(arr, temp, n);
     RadixSort(temp, n);
     printf("After sort: ");
     PrintArray(temp, n);
 
+    printf("\n--- Radix Sort (negative keys) ---\n");
+    int signedArr[] = {49, -38, 65, -97, 0, 13, -2147483647 - 1, 49, 2147483647, -4};
+    printf("Original: ");
+    PrintArray(signedArr, n);
+    RadixSort(signedArr, n);
+    printf("After sort: ");
+    PrintArray(signedArr, n);
+
+    printf("\n--- Generic SortEx (16-byte records) ---\n");
+    const char *algoNames[] = {"insert", "shell", "quick", "heap", "merge"};
+    for (int algo = SORT_INSERT; algo <= SORT_MERGE; algo++) {
+        Record records[10];
+        for (int i = 0; i < n; i++) {
+            records[i].key = arr[i];
+            sprintf(records[i].name, "r%d", i);
+        }
+        SortEx(records, n, sizeof(Record), CompareRecord, algo);
+        printf("%-7s: ", algoNames[algo]);
+        for (int i = 0; i < n; i++) {
+            printf("%d(%s) ", records[i].key, records[i].name);
+        }
+        printf("\n");
+    }
+
+    printf("\n--- American Flag Sort (64-bit key/value pairs) ---\n");
+    KeyValue64 pairs[10];
+    for (int i = 0; i < n; i++) {
+        pairs[i].key = (uint64_t)arr[i] << 40 | (uint64_t)(n - i);
+        pairs[i].value = i;
+    }
+    AmericanFlagSortPairs(pairs, n, 2);
+    printf("After sort (key >> 40 : value): ");
+    for (int i = 0; i < n; i++) {
+        printf("%d:%d ", (int)(pairs[i].key >> 40), (int)pairs[i].value);
+    }
+    printf("\n");
+
     return 0;
 }